@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#define ASSET_CACHE_DEFAULT_MB 4096
+
+// Imported assets (mesh data with BLASes, decoded textures) shared across scene loads. Keys
+// name the file, its modification time and the import flags, so an edited file misses.
+// Above the memory cap the least recently used assets are dropped, assets still referenced
+// by a scene are kept since dropping them would not free their memory. Textures read through
+// the TextureCache count none of their tiles here, those are budgeted by the TextureCache.
+class AssetCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+        size_t capacity = 0;
+    };
+
+    static AssetCache& Get();
+
+    // Key of a file asset, empty when the file does not exist
+    static std::string FileKey(const char* kind, const std::string& path, uint32_t flags = 0);
+
+    // Cached asset for key, or the result of load, which also reports the asset's size.
+    // Failed loads (nullptr) and empty keys are not cached.
+    template <typename T>
+    std::shared_ptr<T> Acquire(const std::string& key, const std::function<std::shared_ptr<T>(size_t& bytes)>& load) {
+        if (!key.empty()) {
+            if (auto cached = Find(key)) return std::static_pointer_cast<T>(cached);
+        }
+        size_t bytes = 0;
+        std::shared_ptr<T> asset = load(bytes);
+        if (asset && !key.empty()) Insert(key, asset, bytes);
+        return asset;
+    }
+
+    // Removes and returns the cached asset of an older version of key's file, so a changed
+    // file can be updated from its previous version. nullptr when there is none.
+    template <typename T>
+    std::shared_ptr<T> TakeSuperseded(const std::string& key) {
+        return key.empty() ? nullptr : std::static_pointer_cast<T>(TakeSupersededEntry(key));
+    }
+
+    // Drops assets over the cap that are no longer referenced, call after a scene is replaced
+    void Trim();
+    void SetCapacity(size_t bytes);
+    void Clear();
+    Stats GetStats() const;
+
+private:
+    AssetCache();
+
+    struct Entry {
+        std::shared_ptr<void> asset;
+        size_t bytes = 0;
+        std::list<std::string>::iterator lru;
+    };
+
+    std::shared_ptr<void> Find(const std::string& key);
+    void Insert(const std::string& key, std::shared_ptr<void> asset, size_t bytes);
+    std::shared_ptr<void> TakeSupersededEntry(const std::string& key);
+    void Evict();
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    std::unordered_map<std::string, std::string> lineages; // Latest key of each file
+    std::list<std::string> lru; // Most recently used first
+    Stats stats;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <memory>
 
 #define _USE_MATH_DEFINES
 #include <cmath>
@@ -27,6 +28,7 @@ public:
     virtual ~Camera() = default;
 
     virtual Ray GenerateRay(float x, float y, int width, int height) const = 0;
+    virtual std::unique_ptr<Camera> Clone() const = 0;
 
     glm::vec3 GetPosition() const { return position; }
     void SetPosition(const glm::vec3& pos) {
@@ -38,6 +40,9 @@ public:
     glm::vec3 GetRight() const { return right; }
     glm::vec3 GetUp() const { return up; }
 
+    glm::mat4 GetCameraToWorld() const { return cameraToWorld; }
+    void SetCameraToWorld(const glm::mat4& m);
+
 protected:
     glm::vec3 position = glm::vec3(0.0f);
     glm::vec3 direction = glm::vec3(0.0f, 0.0f, 1.0f);
@@ -53,6 +58,7 @@ public:
     ~PerspectiveCamera() = default;
 
     Ray GenerateRay(float x, float y, int width, int height) const override;
+    std::unique_ptr<Camera> Clone() const override { return std::make_unique<PerspectiveCamera>(*this); }
 
     float GetFOV() const { return fov; }
     float GetFocalDistance() const { return focalDistance; }
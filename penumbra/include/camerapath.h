@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+// Camera keyframes for animations that only move the camera, one camera to world transform
+// per frame. A path file holds one directive per line, '#' starts a comment:
+//   lookat ex ey ez  tx ty tz  ux uy uz           One frame, as the pbrt LookAt directive
+//   orbit frames radius height  tx ty tz  [ux uy uz]  A circle around the z axis through the
+//                                                 target at the given height, as turntable.py
+//   matrix m00 m01 ... m33                         One frame, camera to world, row major
+namespace CameraPath {
+    // mirrored flips the x axis of lookat and orbit frames, for scenes that Scale -1 1 1
+    // before their LookAt
+    bool Load(const std::string& filename, bool mirrored, std::vector<glm::mat4>& cameraToWorld);
+    glm::mat4 LookAt(const glm::vec3& eye, const glm::vec3& target, const glm::vec3& up);
+}
@@ -7,4 +7,5 @@ namespace Color {
 	void SRGBToLinear(glm::vec3& color);
 	void UnchartedTonemapPartial(glm::vec3& color);
 	void UnchartedTonemapFilmic(glm::vec3& color, float bias = 2.0f);
+	float Luminance(const glm::vec3& color);
 }
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#define DENOISE_PHI_COLOR 4.0f   // Halved every iteration
+#define DENOISE_PHI_NORMAL 32.0f
+#define DENOISE_PHI_ALBEDO 16.0f
+#define DENOISE_MAX_ITERATIONS 10 // The last one reaches 2^9 = 512 pixels away
+#define DENOISE_BAND_ROWS 16 // Rows filtered per work item
+
+// Edge-avoiding A-Trous wavelet filter, guided by first hit albedo and normal buffers.
+// "Edge-Avoiding A-Trous Wavelet Transform for fast Global Illumination Filtering," Dammertz et al. (2010)
+namespace Denoiser {
+    // Calls body(i) for every i in [0, count) in parallel, false once the work is cancelled
+    using ParallelFor = std::function<bool(int count, const std::function<void(int)>& body)>;
+
+    // Each iteration filters bands of rows through parallelFor. False, leaving color as it
+    // was, if it was cancelled.
+    bool ATrous(std::vector<glm::vec3>& color,
+                const std::vector<glm::vec3>& albedo,
+                const std::vector<glm::vec3>& normal,
+                int w, int h, int iterations, const ParallelFor& parallelFor);
+}
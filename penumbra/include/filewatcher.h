@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <filesystem>
+
+#define FILE_WATCH_DEBOUNCE_MS 100 // Quiet time after the last change before reporting, editors save in several steps
+#define FILE_WATCH_POLL_MS 250 // Modification time polling interval where inotify is unavailable
+
+// Watches a set of files on a thread of its own and reports the ones that changed, in one
+// batch once they have been quiet for FILE_WATCH_DEBOUNCE_MS. On Linux the parent directories
+// are watched with inotify, so files replaced by a rename (as most editors and exporters
+// save) are seen too. Elsewhere modification times are polled.
+class FileWatcher {
+public:
+    using Callback = std::function<void(const std::vector<std::string>& changed)>;
+
+    explicit FileWatcher(Callback onChange);
+    ~FileWatcher();
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // Replaces the watched files, an empty list stops watching
+    void Watch(const std::vector<std::string>& files);
+
+    // Absolute and normalized, as changed files are reported
+    static std::string NormalizedPath(const std::string& file);
+
+private:
+    void Loop();
+    std::set<std::string> Poll(); // Files whose modification time changed
+
+    Callback onChange;
+    std::mutex mutex;
+    std::set<std::string> files; // Absolute, normalized
+    std::unordered_map<std::string, std::filesystem::file_time_type> mtimes;
+    std::unordered_map<int, std::string> watchDirs; // inotify watch descriptor to directory
+    int inotifyFd = -1;
+    int wakeFd[2] = { -1, -1 }; // Pipe that interrupts the wait on shutdown
+    std::condition_variable wake; // Interrupts the polling wait on shutdown
+    std::atomic<bool> stop{ false };
+    std::thread thread;
+};
@@ -3,26 +3,68 @@
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
+#include <cstdint>
 #include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
 #include <GLFW/glfw3.h>
 #include <iostream>
 
+#include "assetcache.h"
+#include "texturecache.h"
+
 // NOTE: Defaults considered
 struct RenderSettings {
     // Rendering
     int width = 960;
     int height = 540;
     int spp = 1;
+    int passes = 1; // Progressive, spp samples each
     bool indirect = true;
+    int maxDepth = 64;
+    bool wavefront = false;
+    int threads = 0; // 0: all hardware threads
+    bool pinThreads = false;
+    int numaNodes = 0; // 0: detect, more emulates that many nodes
+    bool numaReplicate = false; // Per node copies of mesh BVHs and attributes
+    int assetCacheMB = ASSET_CACHE_DEFAULT_MB; // Meshes, BLASes and textures kept across loads
+    int textureCacheMB = TEXTURE_CACHE_DEFAULT_MB; // Texture tiles kept in memory
+    bool hotReload = false; // Re-render a frame when its scene, mesh or texture files change
     bool mis = true;
     bool renderLights = false;
     bool renderStereo = false;
 	float stereoIPD = 0.065f;
+    int stereoOutput = 0; // Anaglyph, side by side, separate files
 
     // Env Map
     bool envMapEnabled = true;
     float envMapIntensity = 0.5f;
 
+    // RIS direct lighting
+    bool risDirect = false;
+    int risCandidates = 8;
+    bool risTemporalReuse = false;
+    bool risSpatialReuse = false;
+
+    // Radiance cache
+    bool radianceCache = false;
+    float cacheCellSize = 0.5f;
+    int cacheMaxBounces = 2;
+
+    // Denoiser
+    bool denoise = false;
+    int denoiseIterations = 5;
+
+    // Tiling, orders index TileOrder: scanline, spiral, Morton, Hilbert
+    int tileSize = 16;
+    int tileOrder = 1;
+    int pixelOrder = 0;
+
+    // Animation, consecutive frames render as one batch, those differing only by camera
+    // share a scene. 0: automatic for small frames
+    int animBatch = 0;
+
     // TODO: Remove this, placeholder for my machines only, or add a file system perhaps
 	#if(WIN32)
 		char scenePath[256] = "C:\\Users\\rpadi\\Documents\\Dev\\PenumbraDev\\Penumbra\\resources\\scenes\\toystory_new.pbrt";
@@ -32,6 +74,7 @@ struct RenderSettings {
 		// Animation 
 		char animPath[256] = "C:\\Users\\rpadi\\Documents\\Dev\\PenumbraDev\\anim\\gen\\toystory_new";
 		char saveAnimPath[256] = "C:\\Users\\rpadi\\Documents\\Dev\\PenumbraDev\\animOut\\toystory";
+		char cameraPath[256] = "C:\\Users\\rpadi\\Documents\\Dev\\PenumbraDev\\anim\\turntable.cam";
 	#else
 		char scenePath[256] = "/Users/rafa/Documents/Dev/PenumbraDev/Penumbra/resources/scenes/toystory_new.pbrt";
 		char imgOutPath[256] = "/Users/rafa/Documents/Dev/PenumbraDev/images";
@@ -40,6 +83,7 @@ struct RenderSettings {
 		// Animation 
 		char animPath[256] = "/Users/rafa/Documents/Dev/PenumbraDev/Penumbra/resources/scenes/envmap_anim";
 		char saveAnimPath[256] = "/Users/rafa/Documents/Dev/PenumbraDev/images/envmap_anim";
+		char cameraPath[256] = "/Users/rafa/Documents/Dev/PenumbraDev/Penumbra/resources/scenes/turntable.cam";
 	#endif
 
     // Color
@@ -48,6 +92,30 @@ struct RenderSettings {
 	float exposureBias = 1.0f;
 };
 
+// Editable parameters of the loaded scene's materials and lights, by scene index. Published by
+// the renderer when a frame starts, edited copies are applied between progressive passes.
+struct MaterialParams {
+    enum class Type { Matte, Disney, Other } type = Type::Other;
+    float albedo[3] = { 0.0f, 0.0f, 0.0f };
+    float roughness = 0.5f; // Disney only
+    float metallic = 0.0f;
+    float eta = 1.0f;
+    bool textured = false; // Albedo from a texture, the color is unused
+};
+
+struct LightParams {
+    enum class Type { Point, DiffuseArea, Other } type = Type::Other;
+    float color[3] = { 0.0f, 0.0f, 0.0f }; // Point intensity or area radiance
+    float position[3] = { 0.0f, 0.0f, 0.0f }; // Point only
+    bool twoSided = false; // Area only
+};
+
+struct SceneParams {
+    uint64_t sceneId = 0; // Scene the parameters belong to, edits of a replaced scene are dropped
+    std::vector<MaterialParams> materials;
+    std::vector<LightParams> lights;
+};
+
 class GUI {
 public:
     GUI();
@@ -63,21 +131,45 @@ public:
     void SetRenderCallback(std::function<void()> callback) {
         renderCallback = callback;
     }
+    void SetStopCallback(std::function<void()> callback) {
+        stopCallback = callback;
+    }
     void SetSaveCallback(std::function<void()> callback) {
         saveCallback = callback;
     }
     void SetRenderAnimCallback(std::function<void()> callback) {
         renderAnimCallback = callback;
     }
+    void SetCameraPathCallback(std::function<void()> callback) {
+        cameraPathCallback = callback;
+    }
+    void SetSweepCallback(std::function<void()> callback) {
+        sweepCallback = callback;
+    }
+    void SetSceneEditCallback(std::function<void(const SceneParams&)> callback) {
+        sceneEditCallback = callback;
+    }
+
+    // Called by the renderer, from its control thread
+    void SetSceneParams(const SceneParams& params);
 
     RenderSettings GetRenderSettings() { return renderSettings; }
 
 private:
     std::function<void()> renderCallback;
+    std::function<void()> stopCallback;
 	std::function<void()> saveCallback;
     std::function<void()> renderAnimCallback;
+    std::function<void()> cameraPathCallback;
+    std::function<void()> sweepCallback;
+    std::function<void(const SceneParams&)> sceneEditCallback;
     GLFWwindow* m_window;
     ImFont* font;
 	RenderSettings renderSettings;
+    std::mutex sceneParamsMutex;
+    SceneParams publishedParams; // Latest from the renderer, under sceneParamsMutex
+    bool paramsPublished = false;
+    SceneParams sceneParams; // Edited by the widgets
     void SetupImGuiStyle();
+    void SceneEditor();
 };
\ No newline at end of file
@@ -5,5 +5,11 @@
 #include <iostream>
 
 namespace Image{
+    enum class Format { U8, Half, Float };
+
     bool LoadImage(const char *filename, std::vector<float>& pixels, int &xres, int &yres, int &nchannels);
+    // Reads up to maxChannels channels in a compact format: 8 bit files as U8, others as Half;
+    // Float for everything when compact is false
+    bool LoadImage(const char *filename, std::vector<uint8_t>& texels, int &xres, int &yres, int &nchannels,
+                   Format& format, int maxChannels, bool compact = true);
 }
\ No newline at end of file
@@ -30,6 +30,9 @@ struct LightSample{
 class Light{
 public:
     virtual ~Light() = default;
+
+    // Takes the parameters of a light of the same type, returns true if anything changed
+    virtual bool CopyParameters(const Light& from) = 0;
 };
 
 // === Ideal lights ===
@@ -42,6 +45,9 @@ public:
     virtual LightSample Sample(const HitInfo& hit, Sampler& sampler) = 0;
     virtual float Pdf(const HitInfo& hit, const glm::vec3& wo) const = 0;
     glm::vec3 GetPosition() const { return position; }
+    void SetPosition(const glm::vec3& p) { position = p; }
+    glm::vec3 GetIntensity() const { return intensity; }
+    void SetIntensity(const glm::vec3& I) { intensity = I; }
 
 protected:
     glm::vec3 position;
@@ -57,6 +63,7 @@ public:
     bool Visible(const HitInfo& hit, const Renderer& renderer) override;
     glm::vec3 GetRadiance(const HitInfo& hit) override;
     float Pdf(const HitInfo& hit, const glm::vec3& wo) const override;
+    bool CopyParameters(const Light& from) override;
 };
 
 // === Area lights ===
@@ -74,11 +81,12 @@ public:
     AreaLightType GetType() const { return type; }
 
     virtual LightSample Sample(const HitInfo& hit, Renderer& renderer, Sampler& sampler, const Shape& shape) = 0;
+    virtual LightSample SampleUnoccluded(const HitInfo& hit, Sampler& sampler) = 0;
     virtual bool Visible(const HitInfo& hit, const Renderer& renderer) = 0;
     virtual glm::vec3 GetRadiance(const HitInfo& hit, const Shape& shape) = 0;
     virtual float Pdf(const HitInfo& hit, const Renderer& renderer, const glm::vec3& wi) const = 0;
     Shape* shape = nullptr;
-private:
+protected:
     AreaLightType type;
     glm::vec3 scale;
 };
@@ -89,10 +97,16 @@ public:
     ~DiffuseAreaLight() = default;
 
     LightSample Sample(const HitInfo& hit, Renderer& renderer, Sampler& sampler, const Shape& shape) override;
+    LightSample SampleUnoccluded(const HitInfo& hit, Sampler& sampler) override;
     bool Visible(const HitInfo& hit, const Renderer& renderer) override;
     glm::vec3 GetRadiance(const HitInfo& hit, const Shape& shape) override;
     float GetSurfaceArea() const { return surfaceArea; }
+    glm::vec3 GetEmission() const { return radiance; }
+    void SetEmission(const glm::vec3& L) { radiance = L; }
+    bool IsTwoSided() const { return twoSided; }
+    void SetTwoSided(bool v) { twoSided = v; }
     float Pdf(const HitInfo& hit, const Renderer& renderer, const glm::vec3& wi) const override;
+    bool CopyParameters(const Light& from) override;
 private:
     glm::vec3 radiance;
     bool twoSided;
@@ -12,6 +12,10 @@ public:
     virtual ~Material() = default;
     
     minipbrt::MaterialType GetType() const { return type; }
+
+    // Takes the parameters of a material of the same type, keeping the bound textures.
+    // Returns true if anything changed.
+    virtual bool CopyParameters(const Material& from) = 0;
     
 protected:
     minipbrt::MaterialType type;
@@ -21,6 +25,7 @@ class MatteMaterial : public Material {
 public:
     MatteMaterial(minipbrt::MatteMaterial* pbrtMat);
     ~MatteMaterial() = default;
+    bool CopyParameters(const Material& from) override;
     
     glm::vec3 albedo;
 };
@@ -29,6 +34,7 @@ class DisneyMaterial : public Material {
 public:
     DisneyMaterial(minipbrt::DisneyMaterial* pbrtMat);
     ~DisneyMaterial() = default;
+    bool CopyParameters(const Material& from) override;
 
     // Textured parameters
     ::Texture* albedoTexture = nullptr;
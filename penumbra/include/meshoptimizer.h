@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#define MESH_OPTIMIZE 1 // Weld, clean and reorder meshes on import
+#define MESH_WELD_TOLERANCE 1e-6f // Positions closer than this, relative to the bounds diagonal, weld
+#define MESH_WELD_ATTRIBUTE_EPS 1e-4f // Normals, tangents and UVs closer than this weld
+
+struct SubMesh;
+
+// Import time mesh cleanup. Vertices whose position and attributes agree within tolerance
+// are welded, triangles left degenerate (repeated vertex, zero area) or duplicated are
+// dropped, then triangles are sorted along a Morton curve and vertices numbered in first use
+// order, so the triangles of a BVH leaf and their vertices sit close together in memory.
+// Welding quantizes to a grid, vertices on either side of a cell boundary stay apart.
+namespace MeshOptimizer {
+    // How an optimized mesh was made from the imported one. Deformed versions of the file
+    // get the same remap, so their topology matches and their BLASes can be refit.
+    struct Remap {
+        uint32_t inVerts = 0, inTris = 0;
+        std::vector<uint32_t> vertexSource; // Optimized vertex -> imported vertex
+        std::vector<uint32_t> vertexMap; // Imported vertex -> optimized vertex, ~0u if unused
+        std::vector<uint32_t> triangleSource; // Optimized triangle -> imported triangle
+    };
+
+    struct Stats {
+        uint64_t vertsBefore = 0, vertsAfter = 0;
+        uint64_t trisBefore = 0, trisAfter = 0;
+        uint64_t degenerate = 0, duplicate = 0;
+        Stats& operator+=(const Stats& other);
+    };
+
+    // Optimizes the mesh in place and records its remap
+    Stats Optimize(SubMesh& mesh);
+
+    // Applies the remap of a previous, optimized version of the mesh. False, with the mesh
+    // untouched, when the imported topology differs.
+    bool Reapply(SubMesh& mesh, const SubMesh& previous);
+}
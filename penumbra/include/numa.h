@@ -0,0 +1,20 @@
+#pragma once
+
+#include <vector>
+
+// NUMA topology and thread placement. On Linux nodes are read from sysfs, restricted to the
+// CPUs this process may run on. Elsewhere, or on single socket machines, there is a single
+// node holding every CPU. Configure(n) with n > 0 splits the CPUs into n emulated nodes.
+namespace Numa {
+    void Configure(int emulatedNodes = 0);
+    int NodeCount();
+    const std::vector<int>& NodeCpus(int node);
+
+    // Affinity of the calling thread, node -1 allows every CPU again
+    bool BindCurrentThreadToNode(int node);
+    bool PinCurrentThread(int cpu);
+
+    // Node the calling thread works for, selects per node scene data. 0 unless placed.
+    int CurrentNode();
+    void SetCurrentNode(int node);
+}
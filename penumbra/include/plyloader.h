@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+// Reader for binary PLY meshes, the format our scenes reference. The file is memory mapped,
+// its header parsed and the vertex and face elements read straight out of the mapping.
+// ASCII files and layouts it does not know (triangle strips, for one) are left to Assimp.
+namespace PlyLoader {
+    struct Mesh {
+        std::vector<glm::vec4> vertices; // w = 0
+        std::vector<glm::uvec3> triangles; // Polygons fan triangulated, file winding
+        std::vector<glm::vec3> normals; // Empty when the file has none
+        std::vector<glm::vec2> uvs;
+        std::string texture; // "comment TextureFile", as Assimp reads it
+    };
+
+    // False with the reason in error when the file is not a binary PLY it can read
+    bool Read(const std::string& filename, Mesh& out, std::string& error);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+#include "glm/glm.hpp"
+
+#define RADIANCE_CACHE_CELLS (1 << 20) // Power of two
+#define RADIANCE_CACHE_PROBES 8
+#define RADIANCE_CACHE_MIN_SAMPLES 8
+#define RADIANCE_CACHE_LAYERS 64 // Independent caches in one table, e.g. for frames with their own geometry
+
+// World-space hash grid of outgoing radiance, keyed by (layer, position cell, normal bin).
+// Layers keep radiance of different geometry apart, each one is a cache of its own.
+// Lock-free: cells are claimed with a CAS on their key and accumulated with atomic adds,
+// so render threads can look up and update it concurrently without synchronization.
+class RadianceCache {
+public:
+    RadianceCache() = default;
+    ~RadianceCache() = default;
+
+    void Reset(float cellSize);
+    bool Lookup(const glm::vec3& p, const glm::vec3& n, glm::vec3& L, uint32_t layer = 0) const;
+    void Update(const glm::vec3& p, const glm::vec3& n, const glm::vec3& L, uint32_t layer = 0);
+    uint32_t GetOccupancy() const { return occupied.load(std::memory_order_relaxed); }
+
+private:
+    struct Cell {
+        std::atomic<uint64_t> key{ 0 }; // 0 = empty
+        std::atomic<float> sum[3];
+        std::atomic<uint32_t> count{ 0 };
+    };
+
+    uint64_t CellKey(const glm::vec3& p, const glm::vec3& n, uint32_t layer) const;
+
+    std::unique_ptr<Cell[]> cells;
+    std::atomic<uint32_t> occupied{ 0 };
+    float invCellSize = 1.0f;
+};
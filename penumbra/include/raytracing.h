@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 #include "glm/glm.hpp"
 
 class AreaLight;
@@ -37,4 +39,40 @@ struct HitInfo{
     AreaLight* areaLight = nullptr;
     Shape* shape = nullptr;
     Material* material = nullptr;
-};
\ No newline at end of file
+};
+
+enum PathFlags : uint8_t {
+    PATH_LAST_BOUNCE_DIFFUSE = 1 << 0, // Last bounce sampled a non-delta lobe
+};
+
+// State of one path in the iterative integrator. Everything needed to resume a path
+// lives here, so paths can be suspended between bounces and processed in batches.
+struct PathState {
+    Ray ray;
+    glm::vec3 throughput = glm::vec3(1.0f);
+    glm::vec3 L = glm::vec3(0.0f); // Radiance gathered so far
+    float lastPdf = 0.0f; // BxDF pdf of the last bounce
+    int depth = 0;
+    int pixel = -1;
+    uint8_t flags = 0;
+};
+
+// Radiance cache vertex along a path, with the radiance gathered before reaching it.
+// path tells the paths of a wavefront chunk apart.
+struct CacheRecord {
+    glm::vec3 p = glm::vec3(0.0f);
+    glm::vec3 n = glm::vec3(0.0f);
+    glm::vec3 throughput = glm::vec3(1.0f);
+    glm::vec3 L = glm::vec3(0.0f);
+    int path = -1;
+};
+
+// Shadow ray queued by next event estimation, L is the contribution if unoccluded
+struct ShadowRay {
+    glm::vec3 o = glm::vec3(0.0f);
+    glm::vec3 d = glm::vec3(0.0f);
+    glm::vec3 n = glm::vec3(0.0f);
+    float maxDist = 0.0f;
+    glm::vec3 L = glm::vec3(0.0f);
+    int path = -1;
+};
@@ -4,6 +4,7 @@
 #include <thread>
 #include <filesystem>
 #include <cstdio>
+#include <future>
 
 #include "minipbrt.h"
 #include <OpenImageIO/imageio.h>
@@ -19,6 +20,10 @@
 #include "gui.h"
 #include "color.h"
 #include "environmentmap.h"
+#include "radiancecache.h"
+#include "reservoir.h"
+#include "denoiser.h"
+#include "filewatcher.h"
 
 // TODO: Adaptive sampling 
 // #define MIN_SPP 1 
@@ -29,30 +34,46 @@
 class BVH;
 
 #define OCCLUDED_EPS 1e-4f
-// TODO: Multithread toggle in GUI
+#define WAVEFRONT_BATCH_SIZE 4096 // Paths per wave, per thread
+#define ANIM_ENCODE_QUEUE 2 // Rendered animation frames waiting for the I/O thread
+#define ANIM_BATCH_MAX 16 // Animation frames rendered together
+#define ANIM_BATCH_TILES 8 // Tiles per thread an automatic batch aims for
+// Default thread count, used when RenderSettings::threads is 0
  inline unsigned int NTHREADS = (int)std::thread::hardware_concurrency();
- //inline unsigned int NTHREADS = 2;
 
 class Renderer{
 public:
     Renderer();
     ~Renderer();
     bool SetPbrtScene(minipbrt::Scene* scene);
-    void RenderPixel(int u, int v);
+    void RenderTileMegakernel(const Tile& tile, TileSplitter& splitter);
+    void RenderTileWavefront(const Tile& tile, TileSplitter& splitter);
+    void RenderPixel(int u, int v, const Tile& tile, Sampler& sampler);
     bool TraceRay(const Ray& ray, HitInfo& hit) const;
     bool Occluded(const glm::vec3& o, const glm::vec3& d, const glm::vec3& n, float maxDist) const ;
-    glm::vec3 TracePath(const Ray& ray, Sampler& sampler, int depth, glm::vec3 throughput = glm::vec3(1.0f), bool lastBounceDiffuse = false);
-    void RenderAnimation();
-    void BeginRender();
-    void StopRender();
+    glm::vec3 TracePath(const Ray& ray, Sampler& sampler, int pixel = -1);
+
+    // Render jobs run on a control thread, starting one cancels the job in flight. The
+    // future is true once the job completed, false if it failed or was cancelled.
+    std::shared_future<bool> StartRender(const std::string& scenePath);
+    std::shared_future<bool> StartAnimation();
+    std::shared_future<bool> StartCameraPath(const std::string& scenePath);
+    std::shared_future<bool> StartTilingSweep(const std::string& scenePath);
+    void EditScene(const SceneParams& params); // Applied before the next pass, restarts the accumulation
+    void CancelRender(); // Returns immediately
+    void StopRender(); // Returns once idle
+    bool Cancelled() const { return cancelRequested.load(std::memory_order_relaxed); }
     bool LoadScene(const std::string& filename);
     int GetRenderWidth() const { return renderWidth; }
+    int GetDisplayWidth() const { return displayWidth; } // Twice the render width for side by side stereo
     int GetRenderHeight() const { return renderHeight; }
     void SetRenderWidth(int w) { renderWidth = w; }
     void SetRenderHeight(int h) { renderHeight = h; }
     std::vector<uint8_t>& GetRenderBuffer() { return renderBuffer; }
     void SetGUI(GUI* guiPtr) { gui = guiPtr; }
 	bool SaveImage();
+    static bool WriteFrame(const std::string& fullPath, const uint8_t* pixels, int width, int height, bool splitEyes);
+    static bool WriteImage(const std::string& fullPath, const uint8_t* src, int width, int height, int rowBytes);
     void PrintStats();
 
 
@@ -63,12 +84,55 @@ public:
 
 private:
     BVH* bvh = nullptr;
+    TLAS tlas; // Over scene->shapes
     EnvironmentMap envMap;
+    RadianceCache radianceCache;
+    std::vector<Reservoir> risReservoirs; // Per pixel, primary vertex
+    std::vector<Reservoir> risPassReservoirs; // risReservoirs as of the start of the pass, read by spatial reuse
     std::vector<uint8_t> renderBuffer;
+    std::vector<glm::vec3> film; // Linear HDR radiance, before tonemapping
+    std::vector<glm::vec3> albedoAOV; // First hit features, denoiser guides
+    std::vector<glm::vec3> normalAOV;
     std::unique_ptr<Scene> scene;
     minipbrt::Scene* pbrtScene = nullptr;
     std::unique_ptr<RenderThreadPool> threadPool;
-	bool renderingLeftEye = false;
+    std::atomic<uint64_t> raysTraced{ 0 }; // Closest hit and shadow rays of the current frame
+
+    // Render control
+    enum class RenderJob { Frame, Animation, CameraPath, TilingSweep, HotReload, SceneEdit };
+    struct RenderRequest {
+        RenderJob job = RenderJob::Frame;
+        std::string scenePath; // Empty keeps the current one
+        std::vector<std::string> changedFiles; // HotReload
+        std::promise<bool> done;
+    };
+    std::thread controlThread;
+    std::mutex controlMutex;
+    std::condition_variable controlCv;
+    std::unique_ptr<RenderRequest> pendingRequest;
+    bool controlBusy = false;
+    bool controlShutdown = false;
+    std::atomic<bool> cancelRequested{ false };
+    std::chrono::steady_clock::time_point cancelTime;
+    std::unique_ptr<FileWatcher> watcher; // Scene, mesh and texture files of a hot reloaded frame
+
+    // Live parameter edits. The GUI edits its own copy, the latest one waits here until the
+    // render threads are idle between passes and is then copied into the scene.
+    std::mutex editMutex;
+    SceneParams pendingEdits;
+    bool editsPending = false;
+    std::atomic<uint64_t> sceneId{ 0 }; // Bumped by every scene install
+    int views = 1; // Images rendered per frame, 2 for stereo, one per frame of an animation batch
+    std::vector<const Camera*> viewCameras; // Camera of each view
+    std::vector<glm::vec3> viewOffsets; // Camera offset of each view
+    std::vector<std::unique_ptr<Camera>> batchCameras; // Cameras of batched frames after the first, null with a batch scene
+    // Scene of a batched frame that differs from the installed one by more than its camera
+    struct BatchScene {
+        std::unique_ptr<Scene> scene;
+        TLAS tlas;
+    };
+    std::vector<std::unique_ptr<BatchScene>> batchScenes; // Parallel to batchCameras, null where the frame shares the scene
+    int displayWidth = -1;
 
 
     // --- GUI Variables (defaults not considered) ---
@@ -76,20 +140,48 @@ private:
     // Rendering
     GUI* gui = nullptr;
     bool indirectLighting = false;
+    int maxDepth = -1;
+    bool wavefront = false;
+    int renderThreads = 0;
+    bool pinThreads = false;
+    int numaNodes = 0; // 0: detect
+    bool numaReplicate = false;
+    int tileSize = -1;
+    TileOrder tileOrder = TileOrder::Spiral;
+    TileOrder pixelOrder = TileOrder::Scanline;
     bool misEnabled = false;
     int spp = -1;
+    int passes = -1;
     int renderWidth = -1;
     int renderHeight = -1;
     bool renderLights = false;
+    bool hotReload = false;
 
     // Stereo
+    enum class StereoOutput { Anaglyph, SideBySide, SeparateFiles };
 	bool renderStereo = false;
     float stereoIPD = -1.0f;
+    StereoOutput stereoOutput = StereoOutput::Anaglyph;
 
     // Env Map
 	bool envMapEnabled = false;
 	float envMapIntensity = -1.0f;
 
+    // RIS direct lighting
+    bool risDirect = false;
+    int risCandidates = -1;
+    bool risTemporalReuse = false;
+    bool risSpatialReuse = false;
+
+    // Radiance cache
+    bool radianceCacheEnabled = false;
+    float cacheCellSize = -1.0f;
+    int cacheMaxBounces = -1;
+
+    // Denoiser
+    bool denoise = false;
+    int denoiseIterations = -1;
+
     // Color
     bool gammaCorrect = false;
     bool tonemap = false;
@@ -99,5 +191,86 @@ private:
     char animPath[256] = "";
     char animSavePath[256] = "";
 
-    void ConvertPbrtScene();
+    // Light picked by next event estimation, reused for MIS of the BxDF sample
+    struct LightChoice {
+        IdealLight* idealLight = nullptr;
+        AreaLight* areaLight = nullptr;
+        float pLight = 0.0f;
+    };
+
+    // Scene built off the render thread, installed between frames
+    struct LoadedScene {
+        std::unique_ptr<Scene> scene;
+        minipbrt::Scene* pbrtScene = nullptr;
+        std::vector<std::unique_ptr<Camera>> cameras; // Batched frames after the first, null where the frame has its own scene
+        std::vector<std::unique_ptr<Scene>> scenes; // Parallel to cameras, null where the frame shares the scene
+    };
+    // Encodes finished animation frames on an I/O thread. At most ANIM_ENCODE_QUEUE frames
+    // wait, Push blocks while the I/O thread falls behind.
+    class FrameWriter {
+    public:
+        FrameWriter();
+        ~FrameWriter() { Finish(); }
+        void Push(const std::string& path, std::vector<uint8_t> pixels, int width, int height, bool splitEyes);
+        bool Failed() const { return failed; }
+        bool Finish(); // Waits for the queued frames, false if any failed
+    private:
+        struct Job {
+            std::string path;
+            std::vector<uint8_t> pixels;
+            int width = 0, height = 0;
+            bool splitEyes = false;
+        };
+        BoundedQueue<Job> queue;
+        std::atomic<bool> failed{ false };
+        std::thread thread;
+    };
+    void QueueFrames(FrameWriter& writer, const std::vector<int>& frames);
+    static bool LoadCamera(const std::string& filename, std::unique_ptr<Camera>& out);
+    static size_t SceneBodyHash(const std::string& filename);
+    int AnimationBatchSize(const RenderSettings& rs) const;
+    static bool LoadSceneFile(const std::string& filename, LoadedScene& out);
+    static bool ConvertPbrtScene(minipbrt::Scene* scene, LoadedScene& out);
+    bool RenderScene(const RenderSettings& rs, bool liveEdits = false);
+    std::shared_future<bool> Submit(RenderJob job, const std::string& path, std::vector<std::string> changedFiles = {});
+    void CancelLocked();
+    void ControlLoop();
+    bool BeginRender();
+    bool RenderAnimation();
+    bool RenderCameraPath();
+    bool RunTilingSweep();
+    bool HotReload(const std::vector<std::string>& changedFiles);
+    bool ApplySceneEdits();
+    void WatchSceneFiles(bool enabled);
+    bool RenderEdits();
+    SceneParams CollectSceneParams() const;
+    bool ApplySceneParams();
+    bool EditsWaiting();
+    void ApplyRenderSettings(const RenderSettings& rs);
+    void PrepareFrame();
+    void ResetAccumulation();
+    bool LaunchFrame(bool liveEdits = false);
+    bool RenderPasses(bool liveEdits);
+    void UpdateAccelerationStructures();
+    void ReplicateSceneData();
+    void BindView(int view);
+    Ray CameraRay(float x, float y, int view) const;
+    int PixelIndex(int u, int v, int view) const { return (view * renderHeight + v) * renderWidth + u; }
+    bool TracePrimary(int u, int v, int view, glm::vec3& color, glm::vec3& albedo, glm::vec3& normal);
+    uint32_t PixelSeed(int u, int v, int sampleBegin) const;
+    void StorePixel(int pixel, const glm::vec3& color, const glm::vec3& albedo, const glm::vec3& normal, const Tile& tile);
+    bool ResolveHit(PathState& path, bool hitAny, const HitInfo& hit, Sampler& sampler);
+    bool LookupRadianceCache(const HitInfo& hit, PathState& path, const Material* mat,
+                             std::vector<CacheRecord>& records, int pathId);
+    void UpdateRadianceCache(const CacheRecord& record, const glm::vec3& L);
+    bool SampleDirect(const HitInfo& hit, PathState& path, const Material* mat, Sampler& sampler,
+                      LightChoice& light, ShadowRay& shadow);
+    bool ScatterPath(const HitInfo& hit, PathState& path, const Material* mat, Sampler& sampler,
+                     const LightChoice& light);
+    void WritePixel(int pixel, glm::vec3 color);
+    bool ResolveFilm();
+    bool SampleLightCandidate(const HitInfo& hit, Sampler& sampler, LightCandidate& x, float& sourcePdf);
+    glm::vec3 EvaluateLightCandidate(const HitInfo& hit, const glm::vec3& wo, const Material* mat,
+                                     const LightCandidate& x, glm::vec3& wi, float& dist) const;
+    glm::vec3 SampleDirectRIS(const HitInfo& hit, const glm::vec3& wo, const Material* mat, Sampler& sampler, int pixel);
 };
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#define RIS_SPATIAL_NEIGHBORS 3
+#define RIS_SPATIAL_RADIUS 8 // Pixels
+#define RIS_HISTORY_CAP 20   // Max reused history, in multiples of the candidate count
+
+// A light sample proposed to RIS. For the environment map, p holds the direction.
+struct LightCandidate {
+    glm::vec3 p = glm::vec3(0.0f);
+    glm::vec3 n = glm::vec3(0.0f);
+    glm::vec3 L = glm::vec3(0.0f);
+    int lightIdx = -1; // -1: environment map
+};
+
+// Weighted reservoir for resampled importance sampling (Talbot 2005, Bitterli et al. 2020)
+struct Reservoir {
+    LightCandidate y;
+    float wSum = 0.0f;
+    float M = 0.0f;
+    float W = 0.0f; // Unbiased contribution weight of y
+
+    // Shading point the reservoir was built at, used to validate reuse
+    glm::vec3 shadingN = glm::vec3(0.0f);
+    float hitT = 0.0f;
+
+    bool Update(const LightCandidate& x, float w, float u) {
+        wSum += w;
+        M += 1.0f;
+        if (w > 0.0f && u * wSum < w) {
+            y = x;
+            return true;
+        }
+        return false;
+    }
+
+    // pHat: target function of other.y re-evaluated at this reservoir's shading point
+    bool Combine(const Reservoir& other, float pHat, float u) {
+        float w = pHat * other.W * other.M;
+        float m = M + other.M;
+        bool picked = Update(other.y, w, u);
+        M = m;
+        return picked;
+    }
+};
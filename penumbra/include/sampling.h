@@ -22,6 +22,7 @@ class Sampler {
 public:
     Sampler(uint32_t seed = 0);
     ~Sampler() = default;
+    void Seed(uint32_t seed);
     float Sample1D();
     int SampleInt(int min, int max);
     glm::vec2 SampleHalton2D(uint32_t b1, uint32_t b2, uint32_t index);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <utility>
 #include <vector>
 
 #include "minipbrt.h"
@@ -9,7 +10,29 @@
 #include "lights.h"
 #include "materials.h"
 
+// Owns its shapes, lights, materials and camera. Mesh data and textures belong to the asset
+// cache and live as long as a scene references them.
 struct Scene {
+    Scene() = default;
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+    Scene(Scene&& other) noexcept { *this = std::move(other); }
+    Scene& operator=(Scene&& other) noexcept {
+        std::swap(startTime, other.startTime);
+        std::swap(endTime, other.endTime);
+        std::swap(camera, other.camera);
+        std::swap(shapes, other.shapes);
+        std::swap(lights, other.lights);
+        std::swap(materials, other.materials);
+        return *this;
+    }
+    ~Scene() {
+        for (Shape* shape : shapes) delete shape;
+        for (Light* light : lights) delete light;
+        for (Material* material : materials) delete material;
+        delete camera;
+    }
+
     float startTime = 0.0f;
     float endTime = 0.0f;
 
@@ -73,4 +73,8 @@ namespace Shading {
                    const glm::vec3& wo,
                    const DisneyMaterial* disney,
                    Sampler& sampler);
+
+    bool IsDelta(const Material* material);
+
+    glm::vec3 Albedo(const HitInfo& hit, const Material* material);
 }
\ No newline at end of file
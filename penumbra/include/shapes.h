@@ -1,6 +1,8 @@
 #pragma once
 
 #include <iostream>
+#include <memory>
+#include <mutex>
 
 #define _USE_MATH_DEFINES
 #include <cmath>
@@ -18,6 +20,7 @@
 static_assert(sizeof(tinybvh::bvhvec4) == sizeof(glm::vec4));
 static_assert(alignof(tinybvh::bvhvec4) == alignof(glm::vec4));
 static_assert(sizeof(uint32_t) == 4);
+static_assert(sizeof(glm::uvec3) == 3 * sizeof(uint32_t)); // Triangles are the BLAS index buffer
 
 #include "minipbrt.h"
 #include <assimp/Importer.hpp>
@@ -27,16 +30,25 @@ static_assert(sizeof(uint32_t) == 4);
 #include "raytracing.h"
 #include "pbrtconverter.h"
 #include "texture.h"
+#include "tlas.h"
+#include "meshoptimizer.h"
+
+#define BLAS_REBUILD_SAH_RATIO 1.5f // Refit deforming meshes until their SAH cost exceeds this factor of the last build's
+#define MESH_PACKED_ATTRIBUTES 1 // Quantize and interleave shading attributes on import, 0 keeps them full precision
+#define PACKED_UV_MAX_EXTENT 2.0f // Wider UV ranges (tiled textures) keep full precision UVs when packed
 
 class Shape {
 public:
     virtual ~Shape() = default;
     virtual bool IntersectRay(const Ray& r, HitInfo& hit) = 0;
+    virtual Bounds GetObjectBounds() const = 0;
+    Bounds GetWorldBounds() const { return GetObjectBounds().Transform(transform); }
     
     int GetMaterialId() const { return materialId; }
     int GetAreaLightId() const { return areaLightId; }
     glm::mat4 GetTransform() const { return transform; }
     glm::mat4 GetInverseTransform() const { return inverseTransform; }
+    void SetTransform(const glm::mat4& shapeToWorld);
     glm::vec3 GetPosition() const { return position; }
     glm::vec3 GetScale() const { return scale; }
     bool IsAreaLight() const { return areaLightId != minipbrt::kInvalidIndex; }
@@ -56,41 +68,143 @@ class Sphere : public Shape {
 public:
     Sphere(minipbrt::Sphere* pbrtSphere);
     bool IntersectRay(const Ray& r, HitInfo& hit) override;
+    Bounds GetObjectBounds() const override { return { glm::vec3(-1.0f), glm::vec3(1.0f) }; }
     float GetRadius() const { return radius; }
 private:
     float radius = 1.0f;
 };
 
-struct SubMesh{
-    tinybvh::BVH_SoA bvh;
-    bool bvhReady = false;
+// Shading attributes of a vertex, quantized and interleaved so a hit reads its three vertices
+// from a cache line or two. Directions are octahedral encoded as two 16 bit snorms; the
+// bitangent is rebuilt from the normal and tangent, its handedness in bit 0 of the tangent.
+// UVs are 16 bit unorms over the submesh's UV bounds, when those span at most
+// PACKED_UV_MAX_EXTENT; wider ones would be off by texels of repeated textures, they stay
+// floats in the uvs array.
+struct PackedVertex {
+    uint32_t normal;
+    uint32_t tangent;
+    uint16_t uv[2];
+};
+static_assert(sizeof(PackedVertex) == 12);
+
+// A submesh's geometry in one allocation: positions, triangles, then the attributes the file
+// has, each array 16 byte aligned, absent ones null. Positions are stored once, the BLAS
+// indexes them through the triangles. Packed buffers hold the attributes as PackedVertex
+// records instead of the full precision arrays, and with FullUvs the uvs array as well.
+struct MeshBuffers {
+    enum Attributes : uint32_t { Normals = 1, Uvs = 2, TangentFrames = 4, Packed = 8, FullUvs = 16 };
+
+    MeshBuffers() = default;
+    MeshBuffers(const MeshBuffers&) = delete;
+    MeshBuffers& operator=(const MeshBuffers&) = delete;
+    MeshBuffers(MeshBuffers&& other) noexcept { Swap(other); }
+    MeshBuffers& operator=(MeshBuffers&& other) noexcept { Swap(other); return *this; }
 
     uint32_t nTris = 0;
     uint32_t nVerts = 0;
 
-    std::vector<glm::vec4>* vertices = nullptr;
-    std::vector<glm::uvec4>* triangles = nullptr;
-    std::vector<glm::vec3>* normals = nullptr;
-    std::vector<glm::vec3>* tangents = nullptr;
-    std::vector<glm::vec3>* bitangents = nullptr;
-    std::vector<glm::vec2>* uvs = nullptr;
+    glm::vec4* vertices = nullptr; // w = 0
+    glm::uvec3* triangles = nullptr;
+    glm::vec3* normals = nullptr;
+    glm::vec3* tangents = nullptr;
+    glm::vec3* bitangents = nullptr;
+    glm::vec2* uvs = nullptr;
+    PackedVertex* packed = nullptr;
+    glm::vec2 uvMin = glm::vec2(0.0f); // UV bounds of packed buffers
+    glm::vec2 uvExtent = glm::vec2(0.0f);
+
+    // Replaces the allocation, arrays left uninitialized
+    void Allocate(uint32_t nVerts, uint32_t nTris, uint32_t attributes);
+    uint32_t GetAttributes() const { return attributes; }
+    // Quantizes the full precision attributes into PackedVertex records
+    void Pack();
+    // Object space shading attributes at barycentrics (u, v) of a triangle, unit vectors; the
+    // tangent frame and UV are zero when the mesh has none
+    void Interpolate(const glm::uvec3& tri, float u, float v, glm::vec3& n, glm::vec3& t, glm::vec3& b, glm::vec2& uv) const;
+    bool SameLayout(const MeshBuffers& other) const;
+    // Copies other's arrays, into this allocation when the layouts match, so what points
+    // into it (the BLAS) stays valid
+    void CopyFrom(const MeshBuffers& other);
+    size_t GetBytes() const { return storageSize * sizeof(glm::vec4); }
+    void Swap(MeshBuffers& other) noexcept;
+private:
+    std::unique_ptr<glm::vec4[]> storage;
+    size_t storageSize = 0; // In vec4s
+    uint32_t attributes = 0;
+};
+
+// Copy of a SubMesh's BVH and geometry, built by a thread on one NUMA node so its pages are
+// local to that node (first touch)
+struct SubMeshReplica : MeshBuffers {
+    tinybvh::BVH_SoA bvh;
+};
+
+struct SubMesh : MeshBuffers {
+    SubMesh() = default;
+    SubMesh(const SubMesh&) = delete;
+    SubMesh& operator=(const SubMesh&) = delete;
+
+    tinybvh::BVH_SoA bvh;
+    bool bvhReady = false;
+    bool refittable = false; // Built without spatial splits, so Refit keeps it valid
+    float buildCost = 0.0f; // SAH cost right after the last build
+
+    std::shared_ptr<const MeshOptimizer::Remap> remap; // How the import was optimized, shared by deformed versions
+
+    // Per node copies, replicas[node - 1]; node 0 and missing replicas use the data above
+    std::vector<std::unique_ptr<SubMeshReplica>> replicas;
+    bool replicasStale = false; // Vertices changed and the BVH was refit, the replicas follow
+
+    bool BuildBVH(bool refittable = false);
+    bool RefitBVH();
+    bool ValidateTriangles() const;
+    void BuildReplica(int node);
+    void RefitReplica(int node);
+    size_t GetMemoryBytes() const;
+};
 
-    std::vector<uint32_t> bvhIndices;
-    std::vector<glm::vec4> bvhTriSoup;
+// Imported submeshes of one mesh file with their BLASes and textures. Shared through the
+// asset cache by every TriangleMesh that references the file, so it holds nothing per scene.
+struct MeshAsset {
+    struct Textures {
+        std::shared_ptr<Texture> albedo, roughness, metallic, normal;
+    };
+    std::vector<std::unique_ptr<SubMesh>> subMeshes;
+    std::vector<Textures> textures; // Per submesh
+    Bounds bounds;
 
-    uint32_t materialIndex = 0;
-    bool BuildBVH();
+    // A deformed version of a cached file, same topology, new vertices: its BLASes stay
+    // pending until FinishBLAS refits the previous version's, between frames
+    std::shared_ptr<MeshAsset> previous;
+    bool blasPending = false;
+    std::mutex mutex;
+    void FinishBLAS(int& refit, int& rebuilt);
+    bool SameTopology(const MeshAsset& other) const;
 };
 
 class TriangleMesh : public Shape {
 public:
     TriangleMesh(minipbrt::PLYMesh* plyMesh, Scene& scene, uint32_t shapeIdx);
-    ~TriangleMesh();
+    ~TriangleMesh() = default;
     bool IntersectRay(const Ray& r, HitInfo& hit) override;
-    std::vector<SubMesh*> meshes;
+    Bounds GetObjectBounds() const override { return asset ? asset->bounds : Bounds(); }
+    void UpdateBLAS(int& refit, int& rebuilt);
+    const std::string& GetPath() const { return path; }
+    std::vector<std::string> GetTexturePaths() const;
+    std::vector<SubMesh*> meshes; // Owned by asset
+    std::vector<uint32_t> subMeshMaterials; // Scene material of each submesh
     
 private:
-    bool LoadMeshWithAssimp(const std::string& filename, Scene& scene, uint32_t shapeIdx);
-    Texture* LoadTextureWithAssimp(aiMaterial* mat, aiTextureType type, const char* meshName);
+    std::string path;
+    std::shared_ptr<MeshAsset> asset;
+    std::vector<MeshAsset::Textures> textures; // Bound to the scene materials, per submesh
+    bool LoadMesh(const std::string& filename, Scene& scene, uint32_t shapeIdx);
+    static std::shared_ptr<Texture> LoadTexture(const std::string& path, int channels = 3);
+    static std::shared_ptr<MeshAsset> ImportMesh(const std::string& filename, const std::shared_ptr<MeshAsset>& previous, size_t& bytes);
+    static std::shared_ptr<MeshAsset> LoadMeshWithPly(const std::string& filename, const std::shared_ptr<MeshAsset>& previous, size_t& bytes);
+    static std::shared_ptr<MeshAsset> LoadMeshWithAssimp(const std::string& filename, const std::shared_ptr<MeshAsset>& previous, size_t& bytes);
+    static std::shared_ptr<MeshAsset> FinishImport(std::shared_ptr<MeshAsset> asset, const std::shared_ptr<MeshAsset>& previous, const std::string& filename, size_t& bytes);
+    static std::string ResolveTexturePath(const std::string& path);
+    static std::shared_ptr<Texture> LoadTextureWithAssimp(aiMaterial* mat, aiTextureType type, const char* meshName);
     bool IntersectTriangle(const Ray& r, uint32_t triIdx, HitInfo& hit);
 };
\ No newline at end of file
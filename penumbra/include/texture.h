@@ -14,20 +14,34 @@
 #include "glm/glm.hpp"
 #include "sampling.h"
 #include "image.h"
+#include "texturecache.h"
 
+#define TEXTURE_COMPACT 1 // Keep 8 bit textures as bytes and others as halfs, 0 stores floats
+
+// Image texture, read on demand through the TextureCache, or with TEXTURE_CACHE off loaded
+// whole and stored in the file's precision (see TEXTURE_COMPACT). Texels are converted to
+// float on sample. Scalar maps keep one channel, sampled into all three.
 class Texture{
 public:
     Texture();
     ~Texture();
-    bool Load(const std::string& path);
+    // channels: 3 for colors and normals, 1 for scalar maps (roughness, metallic)
+    bool Load(const std::string& path, int channels = 3);
     glm::vec3 Sample(const glm::vec2& uv) const;
+    // Bytes the AssetCache budgets for the texture. With TEXTURE_CACHE its tiles are owned and
+    // budgeted by the TextureCache, so none.
+    size_t GetMemoryBytes() const { return TEXTURE_CACHE ? 0 : texels.size(); }
+    const std::string& GetPath() const { return path; }
 
 private:
     std::string path;
-    std::vector<float> pixels;
+    std::vector<uint8_t> texels;
+    TextureCache::File* file = nullptr;
+    Image::Format format = Image::Format::Float;
     int xres = 0;
     int yres = 0;
     int nchannels = 0;
+    float Texel(size_t i) const;
 };
 
 std::string TextureTypeToString(aiTextureType type);
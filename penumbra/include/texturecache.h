@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#define TEXTURE_CACHE 1 // Read textures a tile at a time on demand, 0 loads them whole
+#define TEXTURE_CACHE_DEFAULT_MB 1024
+#define TEXTURE_CACHE_TILE_SIZE 64 // Tiles untiled files are read in
+
+// Demand loaded texture tiles shared by every texture, on OIIO's ImageCache. Only the header
+// of a file is read when a texture loads; its tiles (and MIP levels of MIP mapped files) are
+// read on first access. Each thread looks a tile up in its own micro-cache of recent tiles
+// before the shared cache, and above the memory budget the least recently used tiles are
+// dropped, so scenes may reference more texture data than fits in memory.
+class TextureCache {
+public:
+    struct File; // Opaque handle of an opened file
+
+    struct Stats {
+        uint64_t lookups = 0; // Tile lookups
+        uint64_t microMisses = 0; // Missed the thread's micro-cache
+        uint64_t misses = 0; // Missed the shared cache, read from the file
+        uint64_t bytesRead = 0;
+        size_t bytes = 0; // Resident tiles
+        size_t capacity = 0;
+    };
+
+    static TextureCache& Get();
+
+    // Opens a file, reading its header only. Tiles cached from an older version of the file
+    // are dropped. nullptr when it cannot be read.
+    File* Open(const std::string& path, int& xres, int& yres, int& nchannels);
+    // Channels [0, nchannels) of texel (x, y) of the top MIP level, as floats
+    bool Lookup(File* file, int x, int y, int nchannels, float* out) const;
+
+    void SetCapacity(size_t bytes);
+    Stats GetStats() const;
+
+private:
+    TextureCache();
+    ~TextureCache();
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
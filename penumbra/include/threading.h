@@ -5,53 +5,383 @@
 #include <atomic>
 #include <functional>
 #include <mutex>
+#include <deque>
+#include <memory>
+#include <condition_variable>
 #include <random>
 #include <iostream>
 #include <algorithm>
 #include <iomanip>
 #include <chrono>
 #include <sstream>
+#include <cstdint>
+
+#include "numa.h"
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
 
-class Scene;
 class Renderer;
+class RenderThreadPool;
 
-#define TILESIZE 16 
-#define SHUFFLE false
-#define MORTON_ORDERING false // TODO: Investigate why it's slower? 
+#define TILESIZE 16       // Default tile side, in pixels
+#define TILE_SPLIT_MIN 32 // Fewest pixel order steps handed to an idle thread
+#define TILE_CHUNK_STEPS 16 // Pixel order steps kernels render between offers to idle threads
 
-class RenderThreadPool {
+// Traversal order of the tile grid, and of the pixels inside a tile. Selectable at runtime,
+// every order is generated on the fly from cell coordinates.
+enum class TileOrder : uint8_t {
+    Scanline,
+    Spiral,  // Archimedean, outwards from the center
+    Morton,  // Z-order
+    Hilbert
+};
+
+static inline const char* TileOrderName(TileOrder order) {
+    switch (order) {
+    case TileOrder::Scanline: return "Scanline";
+    case TileOrder::Spiral: return "Spiral";
+    case TileOrder::Morton: return "Morton";
+    case TileOrder::Hilbert: return "Hilbert";
+    }
+    return "Unknown";
+}
+
+// Unit of work: a pixel rectangle [x0, x1) x [y0, y1) and the sample range to render in it.
+// Pieces split off a tile keep its rectangle and cover the steps [stepBegin, stepEnd) of its
+// pixel order, so the order stays the one of the whole tile.
+// index identifies the full tile a piece was split from, for cost tracking.
+// view selects the image of a multi view frame, e.g. the stereo eye.
+struct Tile {
+    int x0 = 0, y0 = 0;
+    int x1 = 0, y1 = 0;
+    int sampleBegin = 0, sampleEnd = 0;
+    int stepBegin = 0, stepEnd = -1; // -1 runs to the end of the order
+    int index = 0;
+    int view = 0;
+    TileOrder pixelOrder = TileOrder::Scanline;
+    int Width() const { return x1 - x0; }
+    int Height() const { return y1 - y0; }
+};
+
+// Lets idle threads take over part of a tile while it is being rendered. Kernels render the
+// tile's steps in chunks and call Offer() with the first step not rendered yet before each
+// chunk: while threads are idle, the back half of the remaining steps is queued for them.
+// Returns the end of the steps left to the caller, the cursor itself once the pool stops.
+class TileSplitter {
+public:
+    TileSplitter(RenderThreadPool& pool, int slot, Tile& tile) : pool(pool), slot(slot), tile(tile) {}
+    int Offer(int cursor);
+
+private:
+    RenderThreadPool& pool;
+    int slot;
+    Tile& tile;
+};
+
+// Render kernels are called once per tile and loop over its pixels themselves, keeping their
+// per tile state across the chunks they render (see ForEachChunk)
+class TileKernel {
+public:
+    virtual ~TileKernel() = default;
+    virtual void RenderTile(const Tile& tile, TileSplitter& splitter) = 0;
+};
+
+// Decodes the even bits of a Morton code, a single PEXT where BMI2 is available
+// https://en.wikipedia.org/wiki/Z-order_curve
+static inline uint32_t MortonCompact(uint32_t x) {
+#if defined(__BMI2__)
+    return _pext_u32(x, 0x55555555);
+#else
+    x &= 0x55555555;
+    x = (x | (x >> 1)) & 0x33333333;
+    x = (x | (x >> 2)) & 0x0F0F0F0F;
+    x = (x | (x >> 4)) & 0x00FF00FF;
+    x = (x | (x >> 8)) & 0x0000FFFF;
+    return x;
+#endif
+}
+
+// Maps distance d along the Hilbert curve filling an n x n square (n a power of two) to (x, y)
+// https://en.wikipedia.org/wiki/Hilbert_curve
+static inline void HilbertD2XY(uint32_t n, uint32_t d, uint32_t& x, uint32_t& y) {
+    x = y = 0;
+    for (uint32_t s = 1; s < n; s <<= 1) {
+        uint32_t rx = 1 & (d >> 1);
+        uint32_t ry = 1 & (d ^ rx);
+        if (ry == 0) {
+            if (rx == 1) {
+                x = s - 1 - x;
+                y = s - 1 - y;
+            }
+            std::swap(x, y);
+        }
+        x += s * rx;
+        y += s * ry;
+        d >>= 2;
+    }
+}
+
+// Steps in the traversal of an nx x ny grid. Morton and Hilbert walk the enclosing power of
+// two square, so they take more steps than there are cells when the grid is not that square.
+static inline int GridSteps(int nx, int ny, TileOrder order) {
+    if (nx <= 0 || ny <= 0) return 0;
+    if (order == TileOrder::Scanline || order == TileOrder::Spiral) return nx * ny;
+    int side = 1;
+    while (side < nx || side < ny) side <<= 1;
+    return side * side;
+}
+
+// Splits the steps [begin, end) of an order in two. Morton and Hilbert split on the boundary
+// of the largest aligned quadrant that fits in half the range, so both halves stay compact.
+static inline int SplitSteps(int begin, int end, TileOrder order) {
+    int mid = begin + (end - begin) / 2;
+    if (order == TileOrder::Morton || order == TileOrder::Hilbert) {
+        int quadrant = 1;
+        while (quadrant * 4 <= mid - begin) quadrant *= 4;
+        mid -= mid % quadrant;
+    }
+    return mid;
+}
+
+// Calls f(x, y) once for every cell of an nx x ny grid, in the given order, for the steps
+// [begin, end) of the traversal (see GridSteps). end -1 runs to the last step.
+// Morton and Hilbert walk the enclosing power of two square and skip cells outside the grid.
+template <typename F>
+inline void TraverseGrid(int nx, int ny, TileOrder order, F&& f, int begin = 0, int end = -1) {
+    if (nx <= 0 || ny <= 0) return;
+    const int steps = GridSteps(nx, ny, order);
+    if (end < 0 || end > steps) end = steps;
+    if (begin >= end) return;
+    switch (order) {
+    case TileOrder::Scanline:
+        for (int i = begin, x = begin % nx, y = begin / nx; i < end; i++) {
+            f(x, y);
+            if (++x == nx) { x = 0; y++; }
+        }
+        return;
+    case TileOrder::Spiral: {
+        enum direction { right, down, left, up };
+        direction dir = right;
+        int x = (nx - 1) / 2;
+        int y = (ny - 1) / 2;
+        int visited = 0;
+        unsigned int turns = 0;
+        unsigned int len = 1;
+        while (visited < end) {
+            if (y >= 0 && y < ny && x >= 0 && x < nx) {
+                if (visited >= begin) f(x, y);
+                visited++;
+            }
+            switch (dir) {
+            case right:
+                x++;
+                if (--len == 0) { dir = down; turns++; len = (turns / 2) + 1; }
+                break;
+            case down:
+                y++;
+                if (--len == 0) { dir = left; turns++; len = (turns / 2) + 1; }
+                break;
+            case left:
+                x--;
+                if (--len == 0) { dir = up; turns++; len = (turns / 2) + 1; }
+                break;
+            case up:
+                y--;
+                if (--len == 0) { dir = right; turns++; len = (turns / 2) + 1; }
+                break;
+            }
+        }
+        return;
+    }
+    case TileOrder::Morton:
+    case TileOrder::Hilbert: {
+        uint32_t side = 1;
+        while (side < uint32_t(nx) || side < uint32_t(ny)) side <<= 1;
+        for (uint32_t d = uint32_t(begin); d < uint32_t(end); d++) {
+            uint32_t x, y;
+            if (order == TileOrder::Morton) {
+                x = MortonCompact(d);
+                y = MortonCompact(d >> 1);
+            }
+            else {
+                HilbertD2XY(side, d, x, y);
+            }
+            if (x < uint32_t(nx) && y < uint32_t(ny)) f(int(x), int(y));
+        }
+        return;
+    }
+    }
+}
+
+static inline int TileSteps(const Tile& tile) {
+    return GridSteps(tile.Width(), tile.Height(), tile.pixelOrder);
+}
+
+// Calls f(u, v) for every pixel of the tile's steps, in the tile's pixel order
+template <typename F>
+inline void ForEachPixel(const Tile& tile, F&& f) {
+    TraverseGrid(tile.Width(), tile.Height(), tile.pixelOrder, [&](int x, int y) {
+        f(tile.x0 + x, tile.y0 + y);
+    }, tile.stepBegin, tile.stepEnd);
+}
+
+// Calls f(chunk) for consecutive pieces of at most chunkSteps steps of the tile, chunk being
+// the tile restricted to them. The rest of the steps is offered to idle threads before each.
+template <typename F>
+inline void ForEachChunk(const Tile& tile, TileSplitter& splitter, int chunkSteps, F&& f) {
+    Tile chunk = tile;
+    for (int cursor = tile.stepBegin, end; cursor < (end = splitter.Offer(cursor)); cursor = chunk.stepEnd) {
+        chunk.stepBegin = cursor;
+        chunk.stepEnd = std::min(end, cursor + std::max(1, chunkSteps));
+        f(chunk);
+    }
+}
+
+// Per thread deque of tiles, the owner pops from the front and thieves steal from the back
+struct alignas(64) WorkQueue {
+    std::mutex mutex;
+    std::deque<Tile> items;
+};
+
+// Blocking FIFO holding at most capacity items, hands work between pipeline stages
+template <typename T>
+class BoundedQueue {
 public:
-    RenderThreadPool(Scene* scene, int nThreads, int w, int h)
-        : scene(scene), nThreads(nThreads), w(w), h(h),
-        activeThreads(0), stop(false), tiles(0), tilesW(0), tilesH(0) {
-        tileSize = TILESIZE;
+    explicit BoundedQueue(size_t capacity) : capacity(std::max<size_t>(1, capacity)) {}
+
+    // Blocks while the queue is full
+    void Push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [&] { return items.size() < capacity || closed; });
+        if (closed) return;
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
     }
 
+    // Blocks while the queue is empty, false once it is closed and drained
+    bool Pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [&] { return !items.empty() || closed; });
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void Close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable notFull, notEmpty;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+};
+
+// Persistent pool, created once and reused for every frame. Each frame (or pass) is a job
+// over all tiles, rendered by nThreads - 1 workers plus the submitting thread.
+// Tiles are scheduled by work stealing: each thread owns a deque, idle threads steal from
+// the others and sleep while there is nothing to steal. Between the chunks of a tile being
+// rendered, the rest of it is split off for threads that went idle (see TileSplitter). The
+// time spent per tile is recorded and later passes start with the most expensive tiles.
+// On NUMA machines workers are bound to nodes in contiguous slot ranges, each node renders
+// its own block of tiles and thieves prefer deques of their own node.
+class RenderThreadPool {
+public:
+    RenderThreadPool(int nThreads);
     ~RenderThreadPool();
 
-    void Start(std::function<void(int, int)> render);
+    // Block until the frame is done, the calling thread renders tiles too
+    bool RenderTiles(int w, int h, int views, int sampleBegin, int sampleEnd, TileKernel& kernel);
+    // Calls body(i) for every i in [0, count) as a job on the pool, the calling thread
+    // included, for work outside the tile scheduler. False if the pool was stopped.
+    bool ParallelFor(int count, const std::function<void(int)>& body);
+
+    void Resize(int nThreads);
+    int GetThreadCount() const { return nThreads; }
+    void ResetTileCosts();
+    void SetTiling(int tileSize, TileOrder tileOrder, TileOrder pixelOrder);
+    void SetVerbose(bool verbose) { this->verbose = verbose; }
+    void SetPlacement(bool pinThreads);
+    int GetNodeCount() const { return nodes; }
     void Stop();
-    void Reset();
+    void RequestStop();
+    void Resume();
+    bool Stopped() const { return stop.load(std::memory_order_relaxed); }
     void PrintStats();
     std::chrono::steady_clock::time_point startTime;
     std::atomic<bool> frameFinished;
 
 private:
-    void RenderWorker(std::function<void(int, int)> render);
-    void PrecomputeMortonOrder();
+    friend class TileSplitter;
+    void WorkerLoop(int slot, uint64_t seen);
+    void RenderWorker(int slot);
+    void ForWorker();
+    void ProcessTile(int slot, Tile tile);
+    bool PopLocal(int slot, Tile& tile);
+    bool Steal(int slot, Tile& tile);
+    void Push(int slot, const Tile& tile);
+    void WakeIdle(bool all);
+    void FinishJob();
+    void PlaceThread(int slot, bool& placed);
+    void AssignNodes();
+    void SpawnWorkers();
+    void JoinWorkers();
 
-    Scene* scene;
     int nThreads;
-    int w, h;
+    int w = 0, h = 0;
+    int views = 1;
 
     std::mutex printMutex;
     std::vector<std::thread> workers;
     std::atomic<int> activeThreads;
     std::atomic<bool> stop;
 
+    // Job hand-off, workers sleep on jobCv between frames
+    std::mutex jobMutex;
+    std::condition_variable jobCv;
+    std::condition_variable doneCv;
+    uint64_t jobId = 0;
+    bool shutdown = false;
+    std::mutex frameMutex; // Serializes submitters
+    TileKernel* kernel = nullptr;
+    const std::function<void(int)>* forBody = nullptr; // Set for ParallelFor jobs instead of kernel
+    int forCount = 0;
+    std::atomic<int> forNext{ 0 };
+
+    // Work stealing
+    std::vector<std::unique_ptr<WorkQueue>> queues; // One per thread, slot 0 is the submitter
+    std::atomic<int> outstanding{ 0 }; // Tiles queued or in flight
+    std::atomic<int> queued{ 0 }; // Tiles in the deques
+    std::atomic<int> idleThreads{ 0 };
+    std::mutex idleMutex; // Idle threads sleep on idleCv until a tile is queued or the job ends
+    std::condition_variable idleCv;
+    std::atomic<int> steals{ 0 };
+    std::atomic<int> splits{ 0 };
+    std::atomic<int> remoteSteals{ 0 }; // Taken from a deque of another node
+    std::vector<std::chrono::steady_clock::time_point> finishTimes; // Per slot, for tail idle time
+
+    bool verbose = true; // Per frame stats
+
+    // Thread placement
+    int nodes = 1; // NUMA nodes in use, at most one per thread
+    bool pinThreads = false; // One CPU per thread, otherwise the node's CPUs
+    uint64_t placementVersion = 0; // Bumped on changes, threads re-place themselves at the next job
+    std::vector<int> slotNode;
+
     // Tiling system
-    std::vector<std::vector<int>> grid; // Maps a tile to its pixel indices
-    std::atomic<int> tiles; 
-    int tilesW, tilesH;
-    int tileSize = TILESIZE; // Power of two 
+    std::vector<Tile> grid; // Tile rectangles in tileOrder, reused while the tiling is unchanged
+    std::unique_ptr<std::atomic<uint64_t>[]> tileCost; // Nanoseconds spent per tile and view, accumulated over passes
+    bool hasTileCosts = false;
+    int tileSize = TILESIZE;
+    TileOrder tileOrder = TileOrder::Spiral;
+    TileOrder pixelOrder = TileOrder::Scanline;
 };
\ No newline at end of file
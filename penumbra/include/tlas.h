@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cfloat>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "raytracing.h"
+
+#define TLAS_LEAF_SIZE 2
+#define TLAS_BINS 8
+#define TLAS_STACK 64
+#define TLAS_MAX_DEPTH TLAS_STACK // Nodes this deep stay leaves, so the traversal stack cannot overflow
+#define TLAS_REBUILD_SAH_RATIO 1.5f // Refit until the SAH cost exceeds this factor of the last build's
+
+struct Bounds {
+    glm::vec3 lo = glm::vec3(FLT_MAX);
+    glm::vec3 hi = glm::vec3(-FLT_MAX);
+
+    void Grow(const glm::vec3& p) { lo = glm::min(lo, p); hi = glm::max(hi, p); }
+    void Grow(const Bounds& b) { lo = glm::min(lo, b.lo); hi = glm::max(hi, b.hi); }
+    bool Empty() const { return lo.x > hi.x; }
+    glm::vec3 Center() const { return (lo + hi) * 0.5f; }
+    float Area() const {
+        if (Empty()) return 0.0f;
+        glm::vec3 e = hi - lo;
+        return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+    Bounds Transform(const glm::mat4& m) const;
+};
+
+// Top level BVH over the scene's shapes by their world bounds. Frames that only move shapes
+// refit it, it is rebuilt once refitting has degraded its SAH cost past TLAS_REBUILD_SAH_RATIO.
+class TLAS {
+public:
+    enum class Update { Built, Refit, Rebuilt };
+
+    // Refits to the new bounds of the same shapes, builds when the shape count changed
+    Update Fit(const std::vector<Bounds>& shapeBounds);
+    void Build(const std::vector<Bounds>& shapeBounds);
+    float SAHCost() const;
+    float GetBuildCost() const { return buildCost; }
+
+    // Calls visit(shape) for every shape whose bounds the ray enters before tMax, near first.
+    // visit returns the new tMax, or a negative value to stop.
+    template <typename F>
+    void Traverse(const Ray& ray, float tMax, F&& visit) const {
+        if (nodes.empty()) return;
+        const glm::vec3 invD = 1.0f / ray.d;
+        uint32_t stack[TLAS_STACK];
+        int top = 0;
+        uint32_t node = 0;
+        if (!(Slab(nodes[0], ray.o, invD) < tMax)) return;
+        while (true) {
+            const Node& n = nodes[node];
+            if (n.count > 0) {
+                for (uint32_t i = 0; i < n.count; i++) {
+                    tMax = visit(shapeIndices[n.leftFirst + i]);
+                    if (tMax < 0.0f) return;
+                }
+            }
+            else {
+                uint32_t a = n.leftFirst, b = n.leftFirst + 1;
+                float ta = Slab(nodes[a], ray.o, invD), tb = Slab(nodes[b], ray.o, invD);
+                if (ta > tb) { std::swap(a, b); std::swap(ta, tb); }
+                if (ta < tMax) {
+                    if (tb < tMax) stack[top++] = b; // At most one entry per level, see TLAS_MAX_DEPTH
+                    node = a;
+                    continue;
+                }
+            }
+            // Pop, skipping nodes the ray now reaches only beyond tMax
+            bool found = false;
+            while (top > 0 && !found) {
+                node = stack[--top];
+                found = Slab(nodes[node], ray.o, invD) < tMax;
+            }
+            if (!found) return;
+        }
+    }
+
+private:
+    struct Node {
+        glm::vec3 lo;
+        uint32_t leftFirst = 0; // Left child (right follows) or first shape index
+        glm::vec3 hi;
+        uint32_t count = 0; // Shapes in a leaf, 0 for interior nodes
+    };
+
+    // Entry distance into the node's box, FLT_MAX on a miss
+    static float Slab(const Node& n, const glm::vec3& o, const glm::vec3& invD) {
+        glm::vec3 t0 = (n.lo - o) * invD, t1 = (n.hi - o) * invD;
+        glm::vec3 tn = glm::min(t0, t1), tf = glm::max(t0, t1);
+        float tNear = glm::max(glm::max(tn.x, tn.y), glm::max(tn.z, 0.0f));
+        float tFar = glm::min(glm::min(tf.x, tf.y), tf.z);
+        return tNear <= tFar ? tNear : FLT_MAX;
+    }
+
+    void Subdivide(uint32_t node, const std::vector<Bounds>& shapeBounds, int depth);
+    void Refit(const std::vector<Bounds>& shapeBounds);
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> shapeIndices;
+    float buildCost = 0.0f;
+};
@@ -0,0 +1,104 @@
+#include "assetcache.h"
+
+#include <filesystem>
+
+AssetCache::AssetCache() {
+    stats.capacity = size_t(ASSET_CACHE_DEFAULT_MB) << 20;
+}
+
+AssetCache& AssetCache::Get() {
+    static AssetCache cache;
+    return cache;
+}
+
+std::string AssetCache::FileKey(const char* kind, const std::string& path, uint32_t flags) {
+    std::error_code ec;
+    auto canonical = std::filesystem::canonical(path, ec);
+    if (ec) return "";
+    auto mtime = std::filesystem::last_write_time(canonical, ec);
+    if (ec) return "";
+    return std::string(kind) + ":" + canonical.string() + "|" + std::to_string(flags) + "@" +
+        std::to_string(mtime.time_since_epoch().count());
+}
+
+// Key without the modification time, shared by every version of a file
+static std::string Lineage(const std::string& key) {
+    return key.substr(0, key.rfind('@'));
+}
+
+std::shared_ptr<void> AssetCache::TakeSupersededEntry(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = lineages.find(Lineage(key));
+    if (it == lineages.end() || it->second == key) return nullptr;
+    auto entry = entries.find(it->second);
+    std::shared_ptr<void> asset = std::move(entry->second.asset);
+    stats.bytes -= entry->second.bytes;
+    lru.erase(entry->second.lru);
+    entries.erase(entry);
+    lineages.erase(it);
+    return asset;
+}
+
+std::shared_ptr<void> AssetCache::Find(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        stats.misses++;
+        return nullptr;
+    }
+    stats.hits++;
+    lru.splice(lru.begin(), lru, it->second.lru);
+    return it->second.asset;
+}
+
+void AssetCache::Insert(const std::string& key, std::shared_ptr<void> asset, size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it != entries.end()) return; // Loaded twice concurrently, keep the first
+    lru.push_front(key);
+    entries[key] = { std::move(asset), bytes, lru.begin() };
+    lineages[Lineage(key)] = key;
+    stats.bytes += bytes;
+    Evict();
+}
+
+// Drops unreferenced assets, least recently used first, until under the cap
+void AssetCache::Evict() {
+    for (auto it = lru.end(); stats.bytes > stats.capacity && it != lru.begin();) {
+        --it;
+        auto entry = entries.find(*it);
+        if (entry->second.asset.use_count() > 1) continue;
+        stats.bytes -= entry->second.bytes;
+        stats.evictions++;
+        auto lineage = lineages.find(Lineage(*it));
+        if (lineage != lineages.end() && lineage->second == *it) lineages.erase(lineage);
+        entries.erase(entry);
+        it = lru.erase(it);
+    }
+}
+
+void AssetCache::Trim() {
+    std::lock_guard<std::mutex> lock(mutex);
+    Evict();
+}
+
+void AssetCache::SetCapacity(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.capacity = bytes;
+    Evict();
+}
+
+void AssetCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    lineages.clear();
+    lru.clear();
+    stats.bytes = 0;
+}
+
+AssetCache::Stats AssetCache::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats s = stats;
+    s.entries = entries.size();
+    return s;
+}
@@ -1,6 +1,16 @@
 #include "camera.h"
 #include "pbrtconverter.h"
 
+void Camera::SetCameraToWorld(const glm::mat4& m) {
+    this->cameraToWorld = m;
+    this->worldToCamera = glm::inverse(this->cameraToWorld);
+    this->position = glm::vec3(this->cameraToWorld[3]);
+    this->direction = glm::normalize(glm::vec3(this->cameraToWorld[2]));
+    this->up = glm::normalize(glm::vec3(this->cameraToWorld[1]));
+    this->right = glm::normalize(glm::cross(this->direction, this->up));
+    this->up = glm::normalize(glm::cross(this->right, this->direction));
+}
+
 Ray PerspectiveCamera::GenerateRay(float u, float v, int width, int height) const {
     float camFov = (fov * M_PI) / 180.0f;
     float h = 2.0f * focalDistance * tanf(camFov / 2.0f);
@@ -18,13 +28,7 @@ Ray PerspectiveCamera::GenerateRay(float u, float v, int width, int height) cons
 PerspectiveCamera::PerspectiveCamera(minipbrt::PerspectiveCamera* pbrtCam) {
     if (!pbrtCam) return;
 
-    this->cameraToWorld = PbrtConverter::TransformToMat4(pbrtCam->cameraToWorld);
-    this->worldToCamera = glm::inverse(this->cameraToWorld);
-    this->position = glm::vec3(this->cameraToWorld[3]);
-    this->direction = glm::normalize(glm::vec3(this->cameraToWorld[2]));
-    this->up = glm::normalize(glm::vec3(this->cameraToWorld[1]));
-    this->right = glm::normalize(glm::cross(this->direction, this->up));
-    this->up = glm::normalize(glm::cross(this->right, this->direction));
+    SetCameraToWorld(PbrtConverter::TransformToMat4(pbrtCam->cameraToWorld));
 
     this->fov = pbrtCam->fov;
     this->focalDistance = pbrtCam->focaldistance;
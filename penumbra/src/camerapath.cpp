@@ -0,0 +1,83 @@
+#include "camerapath.h"
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "glm/gtc/constants.hpp"
+
+// Camera to world of the pbrt LookAt directive: +z looks at the target, +y is up
+glm::mat4 CameraPath::LookAt(const glm::vec3& eye, const glm::vec3& target, const glm::vec3& up) {
+    glm::vec3 dir = glm::normalize(target - eye);
+    glm::vec3 right = glm::normalize(glm::cross(glm::normalize(up), dir));
+    glm::vec3 newUp = glm::cross(dir, right);
+    glm::mat4 m(1.0f);
+    m[0] = glm::vec4(right, 0.0f);
+    m[1] = glm::vec4(newUp, 0.0f);
+    m[2] = glm::vec4(dir, 0.0f);
+    m[3] = glm::vec4(eye, 1.0f);
+    return m;
+}
+
+static bool ReadVec3(std::istringstream& line, glm::vec3& v) {
+    return static_cast<bool>(line >> v.x >> v.y >> v.z);
+}
+
+bool CameraPath::Load(const std::string& filename, bool mirrored, std::vector<glm::mat4>& cameraToWorld) {
+    std::ifstream file(filename);
+    if (!file) {
+        std::cerr << "Error: Cannot open camera path: " << filename << std::endl;
+        return false;
+    }
+    cameraToWorld.clear();
+    glm::mat4 mirror(1.0f);
+    if (mirrored) mirror[0][0] = -1.0f;
+
+    std::string text;
+    int lineNumber = 0;
+    while (std::getline(file, text)) {
+        lineNumber++;
+        text = text.substr(0, text.find('#'));
+        std::istringstream line(text);
+        std::string directive;
+        if (!(line >> directive)) continue;
+
+        bool ok = true;
+        if (directive == "lookat") {
+            glm::vec3 eye, target, up;
+            ok = ReadVec3(line, eye) && ReadVec3(line, target) && ReadVec3(line, up);
+            if (ok) cameraToWorld.push_back(LookAt(eye, target, up) * mirror);
+        }
+        else if (directive == "orbit") {
+            int frames = 0;
+            float radius = 0.0f, height = 0.0f;
+            glm::vec3 target, up(0.0f, 0.0f, 1.0f);
+            ok = (line >> frames >> radius >> height) && frames > 0 && ReadVec3(line, target);
+            if (ok && !ReadVec3(line, up)) up = glm::vec3(0.0f, 0.0f, 1.0f);
+            for (int i = 0; ok && i < frames; i++) {
+                float angle = glm::two_pi<float>() * i / frames;
+                glm::vec3 eye(target.x + std::cos(angle) * radius, target.y + std::sin(angle) * radius, height);
+                cameraToWorld.push_back(LookAt(eye, target, up) * mirror);
+            }
+        }
+        else if (directive == "matrix") {
+            glm::mat4 m;
+            for (int r = 0; ok && r < 4; r++) {
+                for (int c = 0; ok && c < 4; c++) ok = static_cast<bool>(line >> m[c][r]);
+            }
+            if (ok) cameraToWorld.push_back(m);
+        }
+        else ok = false;
+
+        if (!ok) {
+            std::cerr << "Error: Invalid camera path directive at " << filename << ":" << lineNumber << std::endl;
+            return false;
+        }
+    }
+    if (cameraToWorld.empty()) {
+        std::cerr << "Error: Camera path has no frames: " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -27,4 +27,9 @@ void Color::UnchartedTonemapFilmic(glm::vec3& color, float exposureBias) {
 	UnchartedTonemapPartial(W);
 	glm::vec3 whiteScale = glm::vec3(1.0f) / W;
 	color = exposed * whiteScale;
+}
+
+// Rec. 709 relative luminance
+float Color::Luminance(const glm::vec3& color) {
+	return 0.2126f * color.r + 0.7152f * color.g + 0.0722f * color.b;
 }
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include "denoiser.h"
+
+#include <cmath>
+#include <algorithm>
+
+// Planar (SoA) buffers, so the per-tap loops over a row vectorize
+struct Planes {
+    std::vector<float> r, g, b;
+    void Resize(size_t n) { r.resize(n); g.resize(n); b.resize(n); }
+};
+
+struct Guides {
+    Planes albedo;
+    Planes normal;
+    std::vector<float> background; // 1 where the primary ray missed
+};
+
+// One tap of the 5x5 kernel for pixels [x0, x1) of a row, dx is the horizontal tap offset.
+// With clampX the tap column is clamped to the image, used only near the left/right borders.
+template <bool clampX>
+static inline void AccumulateTap(const Planes& in, const Guides& g, int w, size_t rowP, size_t rowQ,
+                                 int dx, float k, float invPhiC, int x0, int x1,
+                                 float* sr, float* sg, float* sb, float* sw) {
+    for (int x = x0; x < x1; x++) {
+        size_t p = rowP + x;
+        size_t q = rowQ + (clampX ? std::min(std::max(x + dx, 0), w - 1) : x + dx);
+
+        float dr = in.r[p] - in.r[q];
+        float dg = in.g[p] - in.g[q];
+        float db = in.b[p] - in.b[q];
+        float lum = 0.2126f * in.r[p] + 0.7152f * in.g[p] + 0.0722f * in.b[p];
+        float dc = (dr * dr + dg * dg + db * db) * invPhiC / (lum * lum + 1e-4f);
+
+        float nd = g.normal.r[p] * g.normal.r[q] + g.normal.g[p] * g.normal.g[q] + g.normal.b[p] * g.normal.b[q];
+        float dn = std::max(0.0f, 1.0f - nd) * DENOISE_PHI_NORMAL;
+
+        float ar = g.albedo.r[p] - g.albedo.r[q];
+        float ag = g.albedo.g[p] - g.albedo.g[q];
+        float ab = g.albedo.b[p] - g.albedo.b[q];
+        float da = (ar * ar + ag * ag + ab * ab) * DENOISE_PHI_ALBEDO;
+
+        float wt = k * std::exp(-(dc + dn + da));
+        sr[x] += wt * in.r[q];
+        sg[x] += wt * in.g[q];
+        sb[x] += wt * in.b[q];
+        sw[x] += wt;
+    }
+}
+
+static void FilterRows(const Planes& in, Planes& out, const Guides& g, int w, int h,
+                       int step, float phiC, int y0, int y1) {
+    const float kernel[3] = { 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f }; // B3 spline
+    const float invPhiC = 1.0f / phiC;
+    std::vector<float> sr(w), sg(w), sb(w), sw(w);
+
+    for (int y = y0; y < y1; y++) {
+        std::fill(sr.begin(), sr.end(), 0.0f);
+        std::fill(sg.begin(), sg.end(), 0.0f);
+        std::fill(sb.begin(), sb.end(), 0.0f);
+        std::fill(sw.begin(), sw.end(), 0.0f);
+        size_t rowP = size_t(y) * w;
+
+        for (int j = -2; j <= 2; j++) {
+            int yy = std::min(std::max(y + j * step, 0), h - 1);
+            size_t rowQ = size_t(yy) * w;
+            for (int i = -2; i <= 2; i++) {
+                int dx = i * step;
+                float k = kernel[std::abs(j)] * kernel[std::abs(i)];
+
+                // Columns whose tap stays inside the image take the unclamped (vectorized) path
+                int lo = std::min(w, std::max(0, -dx));
+                int hi = std::max(lo, std::min(w, w - dx));
+                AccumulateTap<true>(in, g, w, rowP, rowQ, dx, k, invPhiC, 0, lo, sr.data(), sg.data(), sb.data(), sw.data());
+                AccumulateTap<false>(in, g, w, rowP, rowQ, dx, k, invPhiC, lo, hi, sr.data(), sg.data(), sb.data(), sw.data());
+                AccumulateTap<true>(in, g, w, rowP, rowQ, dx, k, invPhiC, hi, w, sr.data(), sg.data(), sb.data(), sw.data());
+            }
+        }
+
+        for (int x = 0; x < w; x++) {
+            size_t p = rowP + x;
+            bool keep = g.background[p] > 0.0f || !(sw[x] > 0.0f);
+            float inv = keep ? 0.0f : 1.0f / sw[x];
+            out.r[p] = keep ? in.r[p] : sr[x] * inv;
+            out.g[p] = keep ? in.g[p] : sg[x] * inv;
+            out.b[p] = keep ? in.b[p] : sb[x] * inv;
+        }
+    }
+}
+
+bool Denoiser::ATrous(std::vector<glm::vec3>& color,
+                      const std::vector<glm::vec3>& albedo,
+                      const std::vector<glm::vec3>& normal,
+                      int w, int h, int iterations, const ParallelFor& parallelFor) {
+    const size_t n = size_t(w) * h;
+    if (n == 0 || color.size() < n || albedo.size() < n || normal.size() < n) return true;
+
+    // Demodulate albedo so texture detail is not blurred away, it is multiplied back at the end
+    Planes a, b;
+    Guides g;
+    a.Resize(n);
+    b.Resize(n);
+    g.albedo.Resize(n);
+    g.normal.Resize(n);
+    g.background.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        glm::vec3 alb = glm::max(albedo[i], glm::vec3(1e-3f));
+        a.r[i] = color[i].r / alb.r;
+        a.g[i] = color[i].g / alb.g;
+        a.b[i] = color[i].b / alb.b;
+        g.albedo.r[i] = albedo[i].r;
+        g.albedo.g[i] = albedo[i].g;
+        g.albedo.b[i] = albedo[i].b;
+        g.normal.r[i] = normal[i].x;
+        g.normal.g[i] = normal[i].y;
+        g.normal.b[i] = normal[i].z;
+        g.background[i] = (normal[i].x == 0.0f && normal[i].y == 0.0f && normal[i].z == 0.0f) ? 1.0f : 0.0f;
+    }
+
+    float phiC = DENOISE_PHI_COLOR;
+    const int bands = (h + DENOISE_BAND_ROWS - 1) / DENOISE_BAND_ROWS;
+    for (int it = 0; it < iterations; it++) {
+        int step = 1 << it;
+        bool done = parallelFor(bands, [&](int band) {
+            int y0 = band * DENOISE_BAND_ROWS;
+            FilterRows(a, b, g, w, h, step, phiC, y0, std::min(h, y0 + DENOISE_BAND_ROWS));
+        });
+        if (!done) return false;
+        std::swap(a, b);
+        phiC *= 0.5f;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        glm::vec3 alb = glm::max(albedo[i], glm::vec3(1e-3f));
+        color[i] = glm::vec3(a.r[i], a.g[i], a.b[i]) * alb;
+    }
+    return true;
+}
@@ -0,0 +1,176 @@
+#include "filewatcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+std::string FileWatcher::NormalizedPath(const std::string& file) {
+    std::error_code ec;
+    fs::path p = fs::absolute(file, ec);
+    return (ec ? fs::path(file) : p).lexically_normal().string();
+}
+
+static fs::file_time_type ModificationTime(const std::string& file) {
+    std::error_code ec;
+    fs::file_time_type t = fs::last_write_time(file, ec);
+    return ec ? fs::file_time_type::min() : t;
+}
+
+FileWatcher::FileWatcher(Callback onChange) : onChange(std::move(onChange)) {
+#if defined(__linux__)
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0 || pipe2(wakeFd, O_CLOEXEC) != 0) {
+        std::cerr << "Warning: inotify unavailable, polling watched files" << std::endl;
+        if (inotifyFd >= 0) close(inotifyFd);
+        inotifyFd = -1;
+    }
+#endif
+    thread = std::thread(&FileWatcher::Loop, this);
+}
+
+FileWatcher::~FileWatcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    wake.notify_all();
+#if defined(__linux__)
+    if (inotifyFd >= 0) {
+        char byte = 0;
+        if (write(wakeFd[1], &byte, 1) < 0) {} // The thread also sees stop on its next event
+    }
+#endif
+    thread.join();
+#if defined(__linux__)
+    if (inotifyFd >= 0) {
+        close(inotifyFd); // Drops every watch
+        close(wakeFd[0]);
+        close(wakeFd[1]);
+    }
+#endif
+}
+
+void FileWatcher::Watch(const std::vector<std::string>& watched) {
+    std::lock_guard<std::mutex> lock(mutex);
+    files.clear();
+    mtimes.clear();
+    std::set<std::string> dirs;
+    for (const std::string& file : watched) {
+        std::string path = NormalizedPath(file);
+        files.insert(path);
+        mtimes[path] = ModificationTime(path);
+        dirs.insert(fs::path(path).parent_path().string());
+    }
+#if defined(__linux__)
+    if (inotifyFd < 0) return;
+    for (auto it = watchDirs.begin(); it != watchDirs.end();) {
+        if (dirs.count(it->second)) {
+            dirs.erase(it->second);
+            ++it;
+        } else {
+            inotify_rm_watch(inotifyFd, it->first);
+            it = watchDirs.erase(it);
+        }
+    }
+    for (const std::string& dir : dirs) {
+        int wd = inotify_add_watch(inotifyFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if (wd < 0) {
+            std::cerr << "Warning: Cannot watch directory: " << dir << std::endl;
+            continue;
+        }
+        watchDirs[wd] = dir;
+    }
+#endif
+}
+
+std::set<std::string> FileWatcher::Poll() {
+    std::set<std::string> changed;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& [path, mtime] : mtimes) {
+        fs::file_time_type t = ModificationTime(path);
+        if (t != mtime) {
+            mtime = t;
+            changed.insert(path);
+        }
+    }
+    return changed;
+}
+
+void FileWatcher::Loop() {
+    using Clock = std::chrono::steady_clock;
+    std::set<std::string> pending;
+    Clock::time_point lastChange;
+    auto report = [&]() {
+        std::vector<std::string> changed;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const std::string& path : pending) {
+                if (files.count(path)) changed.push_back(path); // Not unwatched meanwhile
+            }
+        }
+        pending.clear();
+        if (!changed.empty()) onChange(changed);
+    };
+
+#if defined(__linux__)
+    if (inotifyFd >= 0) {
+        alignas(inotify_event) char buffer[16 * 1024];
+        while (!stop) {
+            int timeout = -1;
+            if (!pending.empty()) {
+                auto quiet = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - lastChange).count();
+                timeout = std::max(0, FILE_WATCH_DEBOUNCE_MS - static_cast<int>(quiet));
+            }
+            pollfd fds[2] = { { inotifyFd, POLLIN, 0 }, { wakeFd[0], POLLIN, 0 } };
+            int ready = poll(fds, 2, timeout);
+            if (stop) break;
+            if (ready > 0 && (fds[0].revents & POLLIN)) {
+                ssize_t length;
+                while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    for (char* p = buffer; p < buffer + length;) {
+                        auto event = reinterpret_cast<const inotify_event*>(p);
+                        p += sizeof(inotify_event) + event->len;
+                        auto dir = watchDirs.find(event->wd);
+                        if (event->len == 0 || dir == watchDirs.end()) continue;
+                        std::string path = (fs::path(dir->second) / event->name).lexically_normal().string();
+                        if (!files.count(path)) continue; // Other files in a watched directory
+                        mtimes[path] = ModificationTime(path);
+                        pending.insert(path);
+                        lastChange = Clock::now();
+                    }
+                }
+            }
+            else if (ready == 0 && !pending.empty()) {
+                report();
+            }
+        }
+        return;
+    }
+#endif
+
+    while (!stop) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait_for(lock, std::chrono::milliseconds(FILE_WATCH_POLL_MS), [&] { return stop.load(); });
+        }
+        if (stop) break;
+        std::set<std::string> changed = Poll();
+        if (!changed.empty()) {
+            pending.insert(changed.begin(), changed.end());
+            lastChange = Clock::now();
+        }
+        else if (!pending.empty() && Clock::now() - lastChange >= std::chrono::milliseconds(FILE_WATCH_DEBOUNCE_MS)) {
+            report();
+        }
+    }
+}
@@ -60,6 +60,13 @@ void GUI::Render() {
             }
         }
 
+        // Stop button
+        if (ImGui::Button("Stop", ImVec2(panelWidth, 40.0f))) {
+            if (stopCallback) {
+                stopCallback();
+            }
+        }
+
         // Save button
         if (ImGui::Button("Save", ImVec2(panelWidth, 40.0f))) {
             if (saveCallback) {
@@ -96,9 +103,39 @@ void GUI::Render() {
                 ImGui::Text("Samples per Pixel");
                 ImGui::SetNextItemWidth(150.0f);
                 ImGui::InputInt("##1", &renderSettings.spp, 0, 0);
+                ImGui::Text("Progressive Passes");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::InputInt("##Passes", &renderSettings.passes, 0, 0);
                 ImGui::Text("Indirect Lighting");
                 ImGui::SetNextItemWidth(150.0f);
                 ImGui::Checkbox("##2", &renderSettings.indirect);
+                ImGui::Text("Max Depth");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::InputInt("##MaxDepth", &renderSettings.maxDepth, 0, 0);
+                ImGui::Text("Wavefront");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::Checkbox("##Wavefront", &renderSettings.wavefront);
+                ImGui::Text("Threads (0 = all)");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::InputInt("##Threads", &renderSettings.threads, 0, 0);
+                ImGui::Text("Pin Threads");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::Checkbox("##PinThreads", &renderSettings.pinThreads);
+                ImGui::Text("NUMA Nodes (0 = detect)");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::InputInt("##NumaNodes", &renderSettings.numaNodes, 0, 0);
+                ImGui::Text("Replicate Scene per Node");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::Checkbox("##NumaReplicate", &renderSettings.numaReplicate);
+                ImGui::Text("Asset Cache (MB)");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::InputInt("##AssetCacheMB", &renderSettings.assetCacheMB, 0, 0);
+                ImGui::Text("Texture Cache (MB)");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::InputInt("##TextureCacheMB", &renderSettings.textureCacheMB, 0, 0);
+                ImGui::Text("Hot Reload");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::Checkbox("##HotReload", &renderSettings.hotReload);
                 ImGui::Text("MIS");
                 ImGui::SetNextItemWidth(150.0f);
                 ImGui::Checkbox("##3", &renderSettings.mis);
@@ -111,6 +148,10 @@ void GUI::Render() {
                 ImGui::Text("Stereo IPD");
                 ImGui::SetNextItemWidth(150.0f);
                 ImGui::InputFloat("##6", &renderSettings.stereoIPD);
+                ImGui::Text("Stereo Output");
+                ImGui::SetNextItemWidth(150.0f);
+                const char* stereoOutputs[] = { "Anaglyph", "Side by Side", "Separate Files" };
+                ImGui::Combo("##StereoOutput", &renderSettings.stereoOutput, stereoOutputs, IM_ARRAYSIZE(stereoOutputs));
             }
 
 			// Env. Mapping 
@@ -122,6 +163,64 @@ void GUI::Render() {
                 ImGui::SetNextItemWidth(150.0f);
                 ImGui::InputFloat("##EnvMapIntensity", &renderSettings.envMapIntensity, 0.1f);
             }
+            // RIS direct lighting
+            if (ImGui::CollapsingHeader("Direct Lighting")) {
+                ImGui::Text("RIS Direct Lighting");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::Checkbox("##RISDirect", &renderSettings.risDirect);
+                ImGui::Text("RIS Candidates");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::InputInt("##RISCandidates", &renderSettings.risCandidates, 0, 0);
+                ImGui::Text("Temporal Reuse");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::Checkbox("##RISTemporal", &renderSettings.risTemporalReuse);
+                ImGui::Text("Spatial Reuse");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::Checkbox("##RISSpatial", &renderSettings.risSpatialReuse);
+            }
+
+            // Radiance cache
+            if (ImGui::CollapsingHeader("Radiance Cache")) {
+                ImGui::Text("Radiance Cache");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::Checkbox("##RadianceCache", &renderSettings.radianceCache);
+                ImGui::Text("Cell Size");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::InputFloat("##CacheCellSize", &renderSettings.cacheCellSize, 0.05f);
+                ImGui::Text("Bounces Before Lookup");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::InputInt("##CacheMaxBounces", &renderSettings.cacheMaxBounces, 0, 0);
+            }
+
+            // Denoiser
+            if (ImGui::CollapsingHeader("Denoiser")) {
+                ImGui::Text("Denoise");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::Checkbox("##Denoise", &renderSettings.denoise);
+                ImGui::Text("Filter Iterations");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::InputInt("##DenoiseIterations", &renderSettings.denoiseIterations, 0, 0);
+            }
+
+            // Tiling
+            if (ImGui::CollapsingHeader("Tiling")) {
+                const char* orders[] = { "Scanline", "Spiral", "Morton", "Hilbert" };
+                ImGui::Text("Tile Size");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::InputInt("##TileSize", &renderSettings.tileSize, 0, 0);
+                ImGui::Text("Tile Order");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::Combo("##TileOrder", &renderSettings.tileOrder, orders, IM_ARRAYSIZE(orders));
+                ImGui::Text("Pixel Order");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::Combo("##PixelOrder", &renderSettings.pixelOrder, orders, IM_ARRAYSIZE(orders));
+
+                if (ImGui::Button("Run Tiling Sweep", ImVec2(panelWidth - 10.0f, 40.0f))) {
+                    if (sweepCallback) {
+                        sweepCallback();
+                    }
+                }
+            }
             // Animation
             if (ImGui::CollapsingHeader("Animation")) {
                 ImGui::Text("Anim Files Path");
@@ -132,12 +231,25 @@ void GUI::Render() {
                 ImGui::SetNextItemWidth(150.0f);
                 ImGui::InputText("##5", renderSettings.saveAnimPath, IM_ARRAYSIZE(renderSettings.saveAnimPath));
 
+                ImGui::Text("Frame Batch (0 = auto)");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::InputInt("##AnimBatch", &renderSettings.animBatch, 0, 0);
+
                 ImGui::SetNextItemWidth(150.0f);
                 if (ImGui::Button("Render animation", ImVec2(panelWidth - 10.0f, 40.0f))) {
                     if (renderAnimCallback) {
                         renderAnimCallback();
                     }
                 }
+
+                ImGui::Text("Camera Path File");
+                ImGui::SetNextItemWidth(150.0f);
+                ImGui::InputText("##CameraPath", renderSettings.cameraPath, IM_ARRAYSIZE(renderSettings.cameraPath));
+                if (ImGui::Button("Render camera path", ImVec2(panelWidth - 10.0f, 40.0f))) {
+                    if (cameraPathCallback) {
+                        cameraPathCallback();
+                    }
+                }
             }
 
             // Color
@@ -156,6 +268,13 @@ void GUI::Render() {
             ImGui::Unindent(20.0f);
         }
 
+        // Scene materials and lights, edited live
+        if (ImGui::CollapsingHeader("Scene")) {
+            ImGui::Indent(20.0f);
+            SceneEditor();
+            ImGui::Unindent(20.0f);
+        }
+
         if (font) ImGui::PopFont();
 
     }
@@ -167,6 +286,73 @@ void GUI::Render() {
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
+void GUI::SetSceneParams(const SceneParams& params) {
+    std::lock_guard<std::mutex> lock(sceneParamsMutex);
+    publishedParams = params;
+    paramsPublished = true;
+}
+
+// Widgets for the parameters the renderer published. Every change hands a copy of all of
+// them to the renderer, which applies it before its next pass.
+void GUI::SceneEditor() {
+    {
+        std::lock_guard<std::mutex> lock(sceneParamsMutex);
+        if (paramsPublished) {
+            sceneParams = publishedParams;
+            paramsPublished = false;
+        }
+    }
+    if (sceneParams.materials.empty() && sceneParams.lights.empty()) {
+        ImGui::Text("Render a frame to edit its scene");
+        return;
+    }
+
+    bool edited = false;
+    const ImGuiColorEditFlags hdr = ImGuiColorEditFlags_Float | ImGuiColorEditFlags_HDR;
+    if (ImGui::CollapsingHeader("Materials")) {
+        for (size_t i = 0; i < sceneParams.materials.size(); i++) {
+            MaterialParams& m = sceneParams.materials[i];
+            if (m.type == MaterialParams::Type::Other) continue;
+            ImGui::PushID(static_cast<int>(i));
+            ImGui::Text("Material %zu (%s)", i, m.type == MaterialParams::Type::Matte ? "Matte" : "Disney");
+            if (!m.textured) {
+                ImGui::SetNextItemWidth(150.0f);
+                edited |= ImGui::ColorEdit3("Albedo##Albedo", m.albedo, ImGuiColorEditFlags_Float);
+            }
+            if (m.type == MaterialParams::Type::Disney) {
+                ImGui::SetNextItemWidth(150.0f);
+                edited |= ImGui::SliderFloat("Roughness##Roughness", &m.roughness, 0.0f, 1.0f);
+                ImGui::SetNextItemWidth(150.0f);
+                edited |= ImGui::SliderFloat("Metallic##Metallic", &m.metallic, 0.0f, 1.0f);
+                ImGui::SetNextItemWidth(150.0f);
+                edited |= ImGui::SliderFloat("IOR##Eta", &m.eta, 1.0f, 3.0f);
+            }
+            ImGui::PopID();
+        }
+    }
+    if (ImGui::CollapsingHeader("Lights")) {
+        for (size_t i = 0; i < sceneParams.lights.size(); i++) {
+            LightParams& l = sceneParams.lights[i];
+            if (l.type == LightParams::Type::Other) continue;
+            ImGui::PushID(1000000 + static_cast<int>(i));
+            if (l.type == LightParams::Type::Point) {
+                ImGui::Text("Light %zu (Point)", i);
+                ImGui::SetNextItemWidth(150.0f);
+                edited |= ImGui::ColorEdit3("Intensity##Color", l.color, hdr);
+                ImGui::SetNextItemWidth(150.0f);
+                edited |= ImGui::InputFloat3("Position##Position", l.position);
+            } else {
+                ImGui::Text("Light %zu (Diffuse area)", i);
+                ImGui::SetNextItemWidth(150.0f);
+                edited |= ImGui::ColorEdit3("Radiance##Color", l.color, hdr);
+                edited |= ImGui::Checkbox("Two sided##TwoSided", &l.twoSided);
+            }
+            ImGui::PopID();
+        }
+    }
+    if (edited && sceneEditCallback) sceneEditCallback(sceneParams);
+}
+
 void GUI::SetupImGuiStyle() {
     ImGuiStyle& style = ImGui::GetStyle();
 
@@ -1,5 +1,7 @@
 #include "image.h"
 
+#include <algorithm>
+
 #include <OpenImageIO/imageio.h>
 
 bool Image::LoadImage(const char *filename, std::vector<float>& pixels, int &xres, int &yres, int &nchannels){
@@ -22,4 +24,42 @@ bool Image::LoadImage(const char *filename, std::vector<float>& pixels, int &xre
     }
     inp->close();
     return true;
-}
\ No newline at end of file
+}
+
+bool Image::LoadImage(const char *filename, std::vector<uint8_t>& texels, int &xres, int &yres, int &nchannels,
+                      Format& format, int maxChannels, bool compact){
+    auto inp = OIIO::ImageInput::open(filename);
+    if (!inp) {
+        std::cout << "OIIO open error: " << OIIO::geterror() << std::endl;
+        return false;
+    }
+    const OIIO::ImageSpec& spec = inp->spec();
+    xres      = spec.width;
+    yres      = spec.height;
+    nchannels = std::min(spec.nchannels, maxChannels);
+
+    // OIIO converts to the format asked for while reading, no float copy of the image is made
+    OIIO::TypeDesc type = OIIO::TypeDesc::FLOAT;
+    size_t texelSize = sizeof(float);
+    format = Format::Float;
+    if (compact && spec.format == OIIO::TypeDesc::UINT8) {
+        type = OIIO::TypeDesc::UINT8;
+        texelSize = 1;
+        format = Format::U8;
+    }
+    else if (compact) {
+        type = OIIO::TypeDesc::HALF;
+        texelSize = 2;
+        format = Format::Half;
+    }
+    texels = std::vector<uint8_t>(size_t(xres) * size_t(yres) * size_t(nchannels) * texelSize);
+    bool ok = inp->read_image(0, 0, 0, nchannels, type, texels.data());
+    if (!ok) {
+        std::cout << "OIIO read_image error: " << inp->geterror() << std::endl;
+        std::cout << "Global OIIO error: " << OIIO::geterror() << std::endl;
+        inp->close();
+        return false;
+    }
+    inp->close();
+    return true;
+}
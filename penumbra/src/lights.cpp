@@ -27,6 +27,28 @@ DiffuseAreaLight::DiffuseAreaLight(minipbrt::DiffuseAreaLight* pbrtDiffuseAreaLi
     this->samples = pbrtDiffuseAreaLight->samples;
 }
 
+// === Parameter edits ===
+bool PointLight::CopyParameters(const Light& from) {
+    auto light = dynamic_cast<const PointLight*>(&from);
+    if (!light) return false;
+    bool changed = position != light->position || intensity != light->intensity;
+    position = light->position;
+    intensity = light->intensity;
+    return changed;
+}
+
+bool DiffuseAreaLight::CopyParameters(const Light& from) {
+    auto light = dynamic_cast<const DiffuseAreaLight*>(&from);
+    if (!light) return false;
+    bool changed = scale != light->scale || radiance != light->radiance ||
+                   twoSided != light->twoSided || samples != light->samples;
+    scale = light->scale;
+    radiance = light->radiance;
+    twoSided = light->twoSided;
+    samples = light->samples;
+    return changed;
+}
+
 // === Shadow Factor ===
 bool PointLight::Visible(const HitInfo& hit, const Renderer& renderer) {
     glm::vec3 toLight = position - hit.p;
@@ -137,6 +159,48 @@ LightSample DiffuseAreaLight::Sample(const HitInfo& hit, Renderer& renderer, Sam
     return sample;
 }
 
+// Cheap candidate for RIS: same visible cap sampling as Sample(), but only intersects the light's
+// own shape instead of tracing the scene. Visibility is resolved later with a single shadow ray.
+LightSample DiffuseAreaLight::SampleUnoccluded(const HitInfo& hit, Sampler& sampler) {
+    LightSample sample;
+    sample.L = glm::vec3(0.0f);
+    sample.weight = glm::vec3(0.0f);
+    sample.pdf = 0.0f;
+
+    const Sphere* sphere = dynamic_cast<const Sphere*>(shape);
+    if (!sphere) return sample; // TODO: Implement sampling for other shape types
+
+    glm::vec3 p = sphere->GetPosition();
+    float r = sphere->GetRadius();
+    float r2 = r * r;
+    glm::vec3 tl = p - hit.p;
+    float d = glm::length(tl);
+    float d2 = d * d;
+    if (d2 <= r2) return sample;
+    glm::vec3 wi = tl / d;
+
+    float cosThetaMax = glm::sqrt(1.0f - (r2 / d2));
+    float u = sampler.Sample1D();
+    float cosTheta = 1.0f - u * (1.0f - cosThetaMax);
+    float sinTheta = sqrt(1.0f - cosTheta * cosTheta);
+    float phi = 2 * M_PI * sampler.Sample1D();
+    glm::vec3 dLocal = glm::vec3(cos(phi) * sinTheta, sin(phi) * sinTheta, cosTheta);
+    glm::vec3 b1, b2;
+    Utils::Orthonormals(wi, b1, b2);
+    glm::vec3 dWorld = dLocal.x * b1 + dLocal.y * b2 + dLocal.z * wi;
+
+    Ray lightRay(hit.p + OCCLUDED_EPS * hit.n, dWorld);
+    HitInfo lightHit;
+    if (!shape->IntersectRay(lightRay.Transform(shape->GetInverseTransform()), lightHit)) return sample;
+
+    sample.p = lightHit.p;
+    sample.n = normalize(sample.p - p);
+    sample.pdf = 1.0f / (2.0f * M_PI * (1.0f - cosThetaMax));
+    sample.weight = glm::vec3(1.0f / sample.pdf);
+    sample.L = radiance;
+    return sample;
+}
+
 // === PDFs ===
 float PointLight::Pdf(const HitInfo& hit, const glm::vec3& wo) const {
     return 0.0f;
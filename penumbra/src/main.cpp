@@ -13,7 +13,7 @@ int main() {
 	Viewport viewport(&renderer, 960, 540);
 
     while (!viewport.ShouldClose()) {
-		viewport.UpdateTexture(renderer.GetRenderBuffer(), renderer.GetRenderWidth(), renderer.GetRenderHeight());
+		viewport.UpdateTexture(renderer.GetRenderBuffer(), renderer.GetDisplayWidth(), renderer.GetRenderHeight());
         viewport.PollEvents();
 		viewport.ShowViewport();
     }
@@ -14,4 +14,23 @@ DisneyMaterial::DisneyMaterial(minipbrt::DisneyMaterial* pbrtMat) {
     roughness = pbrtMat->roughness.value;
     metallic = pbrtMat->metallic.value;
     eta = pbrtMat->eta.value;
-}
\ No newline at end of file
+}
+
+bool MatteMaterial::CopyParameters(const Material& from) {
+    if (from.GetType() != type) return false;
+    const auto& m = static_cast<const MatteMaterial&>(from);
+    bool changed = albedo != m.albedo;
+    albedo = m.albedo;
+    return changed;
+}
+
+bool DisneyMaterial::CopyParameters(const Material& from) {
+    if (from.GetType() != type) return false;
+    const auto& m = static_cast<const DisneyMaterial&>(from);
+    bool changed = albedo != m.albedo || roughness != m.roughness || metallic != m.metallic || eta != m.eta;
+    albedo = m.albedo;
+    roughness = m.roughness;
+    metallic = m.metallic;
+    eta = m.eta;
+    return changed;
+}
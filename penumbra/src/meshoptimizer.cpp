@@ -0,0 +1,204 @@
+#include "meshoptimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+
+#include "shapes.h"
+
+MeshOptimizer::Stats& MeshOptimizer::Stats::operator+=(const Stats& other) {
+    vertsBefore += other.vertsBefore;
+    vertsAfter += other.vertsAfter;
+    trisBefore += other.trisBefore;
+    trisAfter += other.trisAfter;
+    degenerate += other.degenerate;
+    duplicate += other.duplicate;
+    return *this;
+}
+
+namespace {
+    // Quantized position and attributes, equal keys weld
+    struct WeldKey {
+        std::array<int64_t, 3> p;
+        std::array<int32_t, 11> a; // Normal, tangent, bitangent, UV
+        bool operator==(const WeldKey& o) const { return p == o.p && a == o.a; }
+    };
+
+    struct WeldKeyHash {
+        size_t operator()(const WeldKey& k) const {
+            uint64_t h = 1469598103934665603ull;
+            auto mix = [&h](uint64_t v) { h = (h ^ v) * 1099511628211ull; };
+            for (int64_t v : k.p) mix(static_cast<uint64_t>(v));
+            for (int32_t v : k.a) mix(static_cast<uint32_t>(v));
+            return static_cast<size_t>(h);
+        }
+    };
+
+    // Spreads the low 10 bits of v to every third bit
+    uint32_t Part1By2(uint32_t v) {
+        v &= 0x3ff;
+        v = (v | (v << 16)) & 0x030000ff;
+        v = (v | (v << 8)) & 0x0300f00f;
+        v = (v | (v << 4)) & 0x030c30c3;
+        v = (v | (v << 2)) & 0x09249249;
+        return v;
+    }
+
+    uint32_t Morton(const glm::vec3& p, const glm::vec3& lo, const glm::vec3& extent) {
+        auto cell = [](float x, float lo, float e) {
+            return e > 0.0f ? static_cast<uint32_t>(std::clamp((x - lo) / e, 0.0f, 1.0f) * 1023.0f) : 0u;
+        };
+        return (Part1By2(cell(p.x, lo.x, extent.x)) << 2) | (Part1By2(cell(p.y, lo.y, extent.y)) << 1) |
+               Part1By2(cell(p.z, lo.z, extent.z));
+    }
+
+    template <typename T>
+    void Gather(T* out, const T* in, const std::vector<uint32_t>& source) {
+        if (!in) return;
+        for (size_t i = 0; i < source.size(); i++) out[i] = in[source[i]];
+    }
+
+    // Rebuilds the mesh's buffers from the imported ones through a remap
+    void ApplyRemap(SubMesh& mesh, const MeshOptimizer::Remap& remap) {
+        MeshBuffers out;
+        out.Allocate(static_cast<uint32_t>(remap.vertexSource.size()), static_cast<uint32_t>(remap.triangleSource.size()),
+                     mesh.GetAttributes());
+        for (size_t t = 0; t < remap.triangleSource.size(); t++) {
+            const glm::uvec3& in = mesh.triangles[remap.triangleSource[t]];
+            out.triangles[t] = glm::uvec3(remap.vertexMap[in.x], remap.vertexMap[in.y], remap.vertexMap[in.z]);
+        }
+        Gather(out.vertices, mesh.vertices, remap.vertexSource);
+        Gather(out.normals, mesh.normals, remap.vertexSource);
+        Gather(out.tangents, mesh.tangents, remap.vertexSource);
+        Gather(out.bitangents, mesh.bitangents, remap.vertexSource);
+        Gather(out.uvs, mesh.uvs, remap.vertexSource);
+        Gather(out.packed, mesh.packed, remap.vertexSource);
+        out.uvMin = mesh.uvMin;
+        out.uvExtent = mesh.uvExtent;
+        static_cast<MeshBuffers&>(mesh) = std::move(out);
+    }
+}
+
+MeshOptimizer::Stats MeshOptimizer::Optimize(SubMesh& mesh) {
+    Stats stats;
+    stats.vertsBefore = stats.vertsAfter = mesh.nVerts;
+    stats.trisBefore = stats.trisAfter = mesh.nTris;
+    if (!mesh.vertices || !mesh.triangles || mesh.nTris == 0) return stats;
+    const glm::vec4* v = mesh.vertices;
+    const glm::uvec3* tris = mesh.triangles;
+
+    glm::vec3 lo(INFINITY), hi(-INFINITY);
+    for (uint32_t i = 0; i < mesh.nVerts; i++) {
+        lo = glm::min(lo, glm::vec3(v[i]));
+        hi = glm::max(hi, glm::vec3(v[i]));
+    }
+    const glm::vec3 extent = hi - lo;
+    const float tolerance = std::max(glm::length(extent) * MESH_WELD_TOLERANCE, 1e-30f);
+
+    // 1. Weld, every vertex points at the first one with its key
+    std::vector<uint32_t> weld(mesh.nVerts);
+    {
+        std::unordered_map<WeldKey, uint32_t, WeldKeyHash> first;
+        first.reserve(mesh.nVerts);
+        auto q = [](float x, float step) { return static_cast<int32_t>(std::lround(x / step)); };
+        for (uint32_t i = 0; i < mesh.nVerts; i++) {
+            WeldKey key{};
+            for (int k = 0; k < 3; k++) key.p[k] = std::llround(static_cast<double>(v[i][k]) / tolerance);
+            const float eps = MESH_WELD_ATTRIBUTE_EPS;
+            for (int k = 0; k < 3; k++) {
+                if (mesh.normals) key.a[k] = q(mesh.normals[i][k], eps);
+                if (mesh.tangents) key.a[3 + k] = q(mesh.tangents[i][k], eps);
+                if (mesh.bitangents) key.a[6 + k] = q(mesh.bitangents[i][k], eps);
+            }
+            if (mesh.uvs) {
+                key.a[9] = q(mesh.uvs[i].x, eps);
+                key.a[10] = q(mesh.uvs[i].y, eps);
+            }
+            weld[i] = first.emplace(key, i).first->second;
+        }
+    }
+
+    // 2. Drop degenerate triangles, then duplicates, the same vertices in the same cyclic
+    // order (reversed copies are kept, they may be meant as two sided)
+    std::vector<std::array<uint32_t, 4>> kept; // Rotated to the smallest index first, then triangle
+    kept.reserve(mesh.nTris);
+    const float minArea2 = tolerance * tolerance * tolerance * tolerance;
+    for (uint32_t t = 0; t < mesh.nTris; t++) {
+        uint32_t a = weld[tris[t].x], b = weld[tris[t].y], c = weld[tris[t].z];
+        glm::vec3 n = glm::cross(glm::vec3(v[b] - v[a]), glm::vec3(v[c] - v[a]));
+        if (a == b || b == c || a == c || glm::dot(n, n) <= minArea2) {
+            stats.degenerate++;
+            continue;
+        }
+        if (b < a && b < c) kept.push_back({ b, c, a, t });
+        else if (c < a && c < b) kept.push_back({ c, a, b, t });
+        else kept.push_back({ a, b, c, t });
+    }
+    std::sort(kept.begin(), kept.end());
+    size_t unique = 0;
+    for (size_t i = 0; i < kept.size(); i++) {
+        if (unique > 0 && kept[unique - 1][0] == kept[i][0] && kept[unique - 1][1] == kept[i][1] &&
+            kept[unique - 1][2] == kept[i][2]) {
+            stats.duplicate++;
+            continue;
+        }
+        kept[unique++] = kept[i];
+    }
+    kept.resize(unique);
+    if (kept.empty()) { // Nothing left to trace, keep the mesh as imported
+        stats.degenerate = stats.duplicate = 0;
+        return stats;
+    }
+
+    // 3. Triangles along a Morton curve of their centroids
+    std::vector<std::pair<uint32_t, uint32_t>> order(kept.size()); // Code, imported triangle
+    for (size_t i = 0; i < kept.size(); i++) {
+        const glm::uvec3& t = tris[kept[i][3]];
+        glm::vec3 centroid = (glm::vec3(v[t.x]) + glm::vec3(v[t.y]) + glm::vec3(v[t.z])) * (1.0f / 3.0f);
+        order[i] = { Morton(centroid, lo, extent), kept[i][3] };
+    }
+    std::sort(order.begin(), order.end());
+
+    // 4. Vertices numbered as the sorted triangles first use them
+    auto remap = std::make_shared<Remap>();
+    remap->inVerts = mesh.nVerts;
+    remap->inTris = mesh.nTris;
+    remap->triangleSource.resize(order.size());
+    std::vector<uint32_t> welded(mesh.nVerts, ~0u); // Welded vertex -> optimized vertex
+    for (size_t i = 0; i < order.size(); i++) {
+        const uint32_t t = order[i].second;
+        remap->triangleSource[i] = t;
+        for (uint32_t in : { tris[t].x, tris[t].y, tris[t].z }) {
+            uint32_t w = weld[in];
+            if (welded[w] == ~0u) {
+                welded[w] = static_cast<uint32_t>(remap->vertexSource.size());
+                remap->vertexSource.push_back(w);
+            }
+        }
+    }
+    remap->vertexMap.resize(mesh.nVerts);
+    for (uint32_t i = 0; i < mesh.nVerts; i++) remap->vertexMap[i] = welded[weld[i]];
+
+    ApplyRemap(mesh, *remap);
+    mesh.remap = remap;
+    stats.vertsAfter = mesh.nVerts;
+    stats.trisAfter = mesh.nTris;
+    return stats;
+}
+
+bool MeshOptimizer::Reapply(SubMesh& mesh, const SubMesh& previous) {
+    const std::shared_ptr<const Remap>& remap = previous.remap;
+    if (!remap || !mesh.vertices || !mesh.triangles || !previous.triangles) return false;
+    if (mesh.nVerts != remap->inVerts || mesh.nTris != remap->inTris) return false;
+    if (previous.nTris != remap->triangleSource.size()) return false;
+    for (size_t t = 0; t < remap->triangleSource.size(); t++) {
+        const glm::uvec3& in = mesh.triangles[remap->triangleSource[t]];
+        const glm::uvec3& out = previous.triangles[t];
+        if (remap->vertexMap[in.x] != out.x || remap->vertexMap[in.y] != out.y || remap->vertexMap[in.z] != out.z) return false;
+    }
+    ApplyRemap(mesh, *remap);
+    mesh.remap = remap;
+    return true;
+}
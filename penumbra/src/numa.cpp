@@ -0,0 +1,141 @@
+#include "numa.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+static std::vector<std::vector<int>> nodes = { {} }; // CPUs per node
+static thread_local int currentNode = 0;
+
+// Parses a sysfs cpulist such as "0-7,16-23"
+static std::vector<int> ParseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty() || range == "\n") continue;
+        size_t dash = range.find('-');
+        try {
+            int lo = std::stoi(range.substr(0, dash));
+            int hi = dash == std::string::npos ? lo : std::stoi(range.substr(dash + 1));
+            for (int c = lo; c <= hi; c++) cpus.push_back(c);
+        }
+        catch (const std::exception&) {
+            continue;
+        }
+    }
+    return cpus;
+}
+
+static std::vector<int> AllowedCpus() {
+    std::vector<int> cpus;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, &set)) cpus.push_back(c);
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        int n = std::max(1u, std::thread::hardware_concurrency());
+        for (int c = 0; c < n; c++) cpus.push_back(c);
+    }
+    return cpus;
+}
+
+// Captured at startup, before any thread is pinned
+static const std::vector<int> processCpus = [] {
+    std::vector<int> cpus = AllowedCpus();
+    std::sort(cpus.begin(), cpus.end());
+    return cpus;
+}();
+
+static std::vector<std::vector<int>> DetectNodes(const std::vector<int>& allowed) {
+    std::vector<std::vector<int>> detected;
+#if defined(__linux__)
+    for (int n = 0; n < 256; n++) {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist");
+        if (!file) continue; // Node ids may have holes
+        std::string list;
+        std::getline(file, list);
+        std::vector<int> cpus;
+        for (int c : ParseCpuList(list)) {
+            if (std::binary_search(allowed.begin(), allowed.end(), c)) cpus.push_back(c);
+        }
+        if (!cpus.empty()) detected.push_back(cpus); // Memory only, or outside our cpuset
+    }
+#endif
+    if (detected.empty()) detected.push_back(allowed);
+    return detected;
+}
+
+void Numa::Configure(int emulatedNodes) {
+    const std::vector<int>& allowed = processCpus;
+    if (emulatedNodes <= 0) {
+        nodes = DetectNodes(allowed);
+        return;
+    }
+
+    // Contiguous CPU ranges of (nearly) equal size. With more nodes than CPUs, nodes share
+    // CPUs, which keeps the scheduling testable on small machines.
+    const size_t count = static_cast<size_t>(emulatedNodes);
+    nodes.assign(count, {});
+    for (size_t i = 0; i < std::max(count, allowed.size()); i++) {
+        nodes[i * count / std::max(count, allowed.size())].push_back(allowed[i % allowed.size()]);
+    }
+}
+
+int Numa::NodeCount() {
+    return static_cast<int>(nodes.size());
+}
+
+const std::vector<int>& Numa::NodeCpus(int node) {
+    return nodes[std::min(std::max(node, 0), NodeCount() - 1)];
+}
+
+#if defined(__linux__)
+static bool SetAffinity(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int c : cpus) {
+        if (c >= 0 && c < CPU_SETSIZE) CPU_SET(c, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+#endif
+
+bool Numa::BindCurrentThreadToNode(int node) {
+#if defined(__linux__)
+    if (node < 0) return SetAffinity(processCpus);
+    return SetAffinity(NodeCpus(node));
+#else
+    (void)node;
+    return false;
+#endif
+}
+
+bool Numa::PinCurrentThread(int cpu) {
+#if defined(__linux__)
+    return SetAffinity({ cpu });
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+int Numa::CurrentNode() {
+    return currentNode;
+}
+
+void Numa::SetCurrentNode(int node) {
+    currentNode = node;
+}
@@ -0,0 +1,409 @@
+#include "plyloader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <sstream>
+#include <utility>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read only mapping of a whole file, unmapped when it goes out of scope
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& filename) {
+#if defined(_WIN32)
+        file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) return;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) return;
+        void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!view) return;
+        bytes = static_cast<const uint8_t*>(view);
+        size = static_cast<size_t>(fileSize.QuadPart);
+#else
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view != MAP_FAILED) {
+                madvise(view, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+                bytes = static_cast<const uint8_t*>(view);
+                size = static_cast<size_t>(st.st_size);
+            }
+        }
+        close(fd); // The mapping stays valid
+#endif
+    }
+
+    ~MappedFile() {
+#if defined(_WIN32)
+        if (bytes) UnmapViewOfFile(bytes);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (bytes) munmap(const_cast<uint8_t*>(bytes), size);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* bytes = nullptr;
+    size_t size = 0;
+
+private:
+#if defined(_WIN32)
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+};
+
+namespace {
+    enum class Type { Invalid, Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+    struct Property {
+        std::string name;
+        Type type = Type::Invalid; // Item type of a list
+        Type countType = Type::Invalid; // Lists only
+        bool list = false;
+    };
+
+    struct Element {
+        std::string name;
+        size_t count = 0;
+        std::vector<Property> properties;
+    };
+
+    Type ParseType(const std::string& name) {
+        if (name == "char" || name == "int8") return Type::Int8;
+        if (name == "uchar" || name == "uint8") return Type::UInt8;
+        if (name == "short" || name == "int16") return Type::Int16;
+        if (name == "ushort" || name == "uint16") return Type::UInt16;
+        if (name == "int" || name == "int32") return Type::Int32;
+        if (name == "uint" || name == "uint32") return Type::UInt32;
+        if (name == "float" || name == "float32") return Type::Float32;
+        if (name == "double" || name == "float64") return Type::Float64;
+        return Type::Invalid;
+    }
+
+    size_t TypeSize(Type type) {
+        switch (type) {
+        case Type::Int8: case Type::UInt8: return 1;
+        case Type::Int16: case Type::UInt16: return 2;
+        case Type::Int32: case Type::UInt32: case Type::Float32: return 4;
+        case Type::Float64: return 8;
+        default: return 0;
+        }
+    }
+
+    template <typename T>
+    T Load(const uint8_t* p, bool swap) {
+        uint8_t b[sizeof(T)];
+        std::memcpy(b, p, sizeof(T));
+        if (swap) {
+            for (size_t i = 0; i < sizeof(T) / 2; i++) std::swap(b[i], b[sizeof(T) - 1 - i]);
+        }
+        T v;
+        std::memcpy(&v, b, sizeof(T));
+        return v;
+    }
+
+    double Scalar(const uint8_t* p, Type type, bool swap) {
+        switch (type) {
+        case Type::Int8: return static_cast<int8_t>(*p);
+        case Type::UInt8: return *p;
+        case Type::Int16: return Load<int16_t>(p, swap);
+        case Type::UInt16: return Load<uint16_t>(p, swap);
+        case Type::Int32: return Load<int32_t>(p, swap);
+        case Type::UInt32: return Load<uint32_t>(p, swap);
+        case Type::Float32: return Load<float>(p, swap);
+        case Type::Float64: return Load<double>(p, swap);
+        default: return 0.0;
+        }
+    }
+
+    // Floats stored in host byte order, the common case, skip the conversion
+    inline float Float(const uint8_t* p, Type type, bool swap) {
+        if (type == Type::Float32 && !swap) {
+            float v;
+            std::memcpy(&v, p, sizeof(float));
+            return v;
+        }
+        return static_cast<float>(Scalar(p, type, swap));
+    }
+
+    bool HostLittleEndian() {
+        const uint16_t one = 1;
+        uint8_t first;
+        std::memcpy(&first, &one, 1);
+        return first == 1;
+    }
+
+    int FindProperty(const Element& e, std::initializer_list<const char*> names) {
+        for (const char* name : names) {
+            for (size_t i = 0; i < e.properties.size(); i++) {
+                if (!e.properties[i].list && e.properties[i].name == name) return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+}
+
+bool PlyLoader::Read(const std::string& filename, Mesh& out, std::string& error) {
+    MappedFile file(filename);
+    if (!file.bytes) {
+        error = "cannot map file";
+        return false;
+    }
+
+    // Header, ASCII lines up to end_header
+    const char* text = reinterpret_cast<const char*>(file.bytes);
+    const size_t scan = std::min<size_t>(file.size, 1 << 16);
+    size_t headerEnd = std::string::npos;
+    for (size_t i = 0; i + 10 <= scan; i++) {
+        if (std::memcmp(text + i, "end_header", 10) == 0) {
+            headerEnd = i + 10;
+            break;
+        }
+    }
+    if (scan < 3 || std::memcmp(text, "ply", 3) != 0 || headerEnd == std::string::npos) {
+        error = "no PLY header";
+        return false;
+    }
+    while (headerEnd < file.size && file.bytes[headerEnd] != '\n') headerEnd++; // "\r\n" endings
+    std::istringstream header(std::string(text, headerEnd));
+    headerEnd++;
+
+    bool swap = false, binary = false;
+    std::vector<Element> elements;
+    std::string line;
+    while (std::getline(header, line)) {
+        std::istringstream ss(line);
+        std::string keyword;
+        ss >> keyword;
+        if (keyword == "format") {
+            std::string format;
+            ss >> format;
+            if (format == "ascii") {
+                error = "ASCII PLY";
+                return false;
+            }
+            if (format != "binary_little_endian" && format != "binary_big_endian") {
+                error = "unknown format " + format;
+                return false;
+            }
+            swap = (format == "binary_little_endian") != HostLittleEndian();
+            binary = true;
+        }
+        else if (keyword == "comment") {
+            std::string tag;
+            ss >> tag;
+            if (tag == "TextureFile") ss >> out.texture;
+        }
+        else if (keyword == "element") {
+            Element e;
+            ss >> e.name >> e.count;
+            elements.push_back(e);
+        }
+        else if (keyword == "property") {
+            if (elements.empty()) {
+                error = "property outside an element";
+                return false;
+            }
+            Property p;
+            std::string type;
+            ss >> type;
+            if (type == "list") {
+                std::string countType, itemType;
+                ss >> countType >> itemType;
+                p.list = true;
+                p.countType = ParseType(countType);
+                p.type = ParseType(itemType);
+                if (p.countType == Type::Invalid) {
+                    error = "unknown list count type " + countType;
+                    return false;
+                }
+            }
+            else {
+                p.type = ParseType(type);
+            }
+            ss >> p.name;
+            if (p.type == Type::Invalid) {
+                error = "unknown type of property " + p.name;
+                return false;
+            }
+            elements.back().properties.push_back(p);
+        }
+    }
+
+    if (!binary) {
+        error = "no format line";
+        return false;
+    }
+
+    const uint8_t* p = file.bytes + headerEnd;
+    const uint8_t* end = file.bytes + file.size;
+    auto truncated = [&](size_t bytes) { return static_cast<size_t>(end - p) < bytes; };
+    bool hasVertices = false, hasFaces = false;
+    for (const Element& e : elements) {
+        // Offsets of fixed size properties, lists make the record size vary
+        std::vector<size_t> offsets;
+        size_t stride = 0;
+        bool fixed = true;
+        for (const Property& prop : e.properties) {
+            offsets.push_back(stride);
+            if (prop.list) fixed = false;
+            else stride += TypeSize(prop.type);
+        }
+
+        if (e.name == "vertex") {
+            if (!fixed) {
+                error = "list property in vertex element";
+                return false;
+            }
+            int x = FindProperty(e, { "x" }), y = FindProperty(e, { "y" }), z = FindProperty(e, { "z" });
+            int nx = FindProperty(e, { "nx" }), ny = FindProperty(e, { "ny" }), nz = FindProperty(e, { "nz" });
+            int u = FindProperty(e, { "u", "s", "texture_u", "texture_s" });
+            int v = FindProperty(e, { "v", "t", "texture_v", "texture_t" });
+            if (x < 0 || y < 0 || z < 0) {
+                error = "vertex without positions";
+                return false;
+            }
+            if (e.count > 0 && truncated(e.count * stride)) {
+                error = "truncated vertex data";
+                return false;
+            }
+            const bool normals = nx >= 0 && ny >= 0 && nz >= 0, uvs = u >= 0 && v >= 0;
+            out.vertices.resize(e.count);
+            if (normals) out.normals.resize(e.count);
+            if (uvs) out.uvs.resize(e.count);
+            const auto& props = e.properties;
+            for (size_t i = 0; i < e.count; i++, p += stride) {
+                out.vertices[i] = glm::vec4(Float(p + offsets[x], props[x].type, swap),
+                                            Float(p + offsets[y], props[y].type, swap),
+                                            Float(p + offsets[z], props[z].type, swap), 0.0f);
+                if (normals) {
+                    out.normals[i] = glm::vec3(Float(p + offsets[nx], props[nx].type, swap),
+                                               Float(p + offsets[ny], props[ny].type, swap),
+                                               Float(p + offsets[nz], props[nz].type, swap));
+                }
+                if (uvs) {
+                    out.uvs[i] = glm::vec2(Float(p + offsets[u], props[u].type, swap),
+                                           Float(p + offsets[v], props[v].type, swap));
+                }
+            }
+            hasVertices = true;
+        }
+        else if (e.name == "face") {
+            int indices = -1;
+            for (size_t i = 0; i < e.properties.size(); i++) {
+                const Property& prop = e.properties[i];
+                if (prop.list && (prop.name == "vertex_indices" || prop.name == "vertex_index")) indices = static_cast<int>(i);
+            }
+            if (indices < 0) {
+                error = "face without vertex indices";
+                return false;
+            }
+            out.triangles.reserve(e.count);
+            std::vector<uint32_t> polygon;
+            for (size_t f = 0; f < e.count; f++) {
+                for (size_t k = 0; k < e.properties.size(); k++) {
+                    const Property& prop = e.properties[k];
+                    const size_t itemSize = TypeSize(prop.type);
+                    if (!prop.list) {
+                        if (truncated(itemSize)) {
+                            error = "truncated face data";
+                            return false;
+                        }
+                        p += itemSize;
+                        continue;
+                    }
+                    const size_t countSize = TypeSize(prop.countType);
+                    if (truncated(countSize)) {
+                        error = "truncated face data";
+                        return false;
+                    }
+                    const size_t n = static_cast<size_t>(Scalar(p, prop.countType, swap));
+                    p += countSize;
+                    if (truncated(n * itemSize)) {
+                        error = "truncated face data";
+                        return false;
+                    }
+                    if (static_cast<int>(k) == indices && n == 3 && itemSize == 4 && !swap &&
+                        (prop.type == Type::Int32 || prop.type == Type::UInt32)) {
+                        uint32_t tri[3]; // Triangles in host byte order, the common case
+                        std::memcpy(tri, p, sizeof(tri));
+                        out.triangles.emplace_back(tri[0], tri[1], tri[2]);
+                    }
+                    else if (static_cast<int>(k) == indices) {
+                        polygon.resize(n);
+                        for (size_t i = 0; i < n; i++) polygon[i] = static_cast<uint32_t>(Scalar(p + i * itemSize, prop.type, swap));
+                        for (size_t i = 2; i < n; i++) out.triangles.emplace_back(polygon[0], polygon[i - 1], polygon[i]);
+                    }
+                    p += n * itemSize;
+                }
+            }
+            hasFaces = true;
+        }
+        else {
+            // Elements we do not use, skipped record by record when they hold lists
+            if (fixed) {
+                if (truncated(e.count * stride)) {
+                    error = "truncated " + e.name + " data";
+                    return false;
+                }
+                p += e.count * stride;
+                continue;
+            }
+            if (e.name == "tristrips") {
+                error = "triangle strips";
+                return false;
+            }
+            for (size_t r = 0; r < e.count; r++) {
+                for (const Property& prop : e.properties) {
+                    size_t bytes = TypeSize(prop.list ? prop.countType : prop.type);
+                    if (truncated(bytes)) {
+                        error = "truncated " + e.name + " data";
+                        return false;
+                    }
+                    if (prop.list) {
+                        size_t n = static_cast<size_t>(Scalar(p, prop.countType, swap));
+                        p += bytes;
+                        bytes = n * TypeSize(prop.type);
+                        if (truncated(bytes)) {
+                            error = "truncated " + e.name + " data";
+                            return false;
+                        }
+                    }
+                    p += bytes;
+                }
+            }
+        }
+    }
+
+    if (!hasVertices || !hasFaces || out.triangles.empty()) {
+        error = "no triangles";
+        return false;
+    }
+    const uint32_t nVerts = static_cast<uint32_t>(out.vertices.size());
+    for (const glm::uvec3& t : out.triangles) {
+        if (t.x >= nVerts || t.y >= nVerts || t.z >= nVerts) {
+            error = "vertex index out of range";
+            return false;
+        }
+    }
+    return true;
+}
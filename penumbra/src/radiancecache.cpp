@@ -0,0 +1,91 @@
+#include "radiancecache.h"
+
+// Murmur3 finalizer, spreads the packed cell coordinates over the table
+static inline uint64_t MixHash(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ull;
+    k ^= k >> 33;
+    return k;
+}
+
+static inline void AtomicAdd(std::atomic<float>& a, float v) {
+    float old = a.load(std::memory_order_relaxed);
+    while (!a.compare_exchange_weak(old, old + v, std::memory_order_relaxed)) {}
+}
+
+// Cells are allocated on first use, the cache is off by default
+void RadianceCache::Reset(float cellSize) {
+    if (!cells) cells = std::make_unique<Cell[]>(RADIANCE_CACHE_CELLS);
+    invCellSize = 1.0f / glm::max(cellSize, 1e-4f);
+    for (uint32_t i = 0; i < RADIANCE_CACHE_CELLS; i++) {
+        cells[i].key.store(0, std::memory_order_relaxed);
+        cells[i].sum[0].store(0.0f, std::memory_order_relaxed);
+        cells[i].sum[1].store(0.0f, std::memory_order_relaxed);
+        cells[i].sum[2].store(0.0f, std::memory_order_relaxed);
+        cells[i].count.store(0, std::memory_order_relaxed);
+    }
+    occupied = 0;
+}
+
+// Packs 18 bits per cell axis, the layer (6 bits) and the dominant normal axis (6 bins)
+// into one key, the top bit keeps valid keys distinct from empty cells
+uint64_t RadianceCache::CellKey(const glm::vec3& p, const glm::vec3& n, uint32_t layer) const {
+    static_assert(RADIANCE_CACHE_LAYERS == 64, "layers take 6 bits of the key");
+    glm::ivec3 c = glm::ivec3(glm::floor(p * invCellSize));
+    glm::vec3 a = glm::abs(n);
+    uint64_t axis = (a.x > a.y && a.x > a.z) ? 0 : (a.y > a.z ? 1 : 2);
+    uint64_t sign = n[int(axis)] < 0.0f ? 1 : 0;
+    uint64_t key = (uint64_t(uint32_t(c.x) & 0x3FFFF)) |
+                   (uint64_t(uint32_t(c.y) & 0x3FFFF) << 18) |
+                   (uint64_t(uint32_t(c.z) & 0x3FFFF) << 36) |
+                   (uint64_t(layer & (RADIANCE_CACHE_LAYERS - 1)) << 54) |
+                   ((axis * 2 + sign) << 60);
+    return key | (1ull << 63);
+}
+
+bool RadianceCache::Lookup(const glm::vec3& p, const glm::vec3& n, glm::vec3& L, uint32_t layer) const {
+    if (!cells) return false;
+    uint64_t key = CellKey(p, n, layer);
+    uint64_t h = MixHash(key);
+    for (uint32_t i = 0; i < RADIANCE_CACHE_PROBES; i++) {
+        const Cell& cell = cells[(h + i) & (RADIANCE_CACHE_CELLS - 1)];
+        uint64_t k = cell.key.load(std::memory_order_acquire);
+        if (k == 0) return false;
+        if (k != key) continue;
+        uint32_t count = cell.count.load(std::memory_order_relaxed);
+        if (count < RADIANCE_CACHE_MIN_SAMPLES) return false;
+        L = glm::vec3(cell.sum[0].load(std::memory_order_relaxed),
+                      cell.sum[1].load(std::memory_order_relaxed),
+                      cell.sum[2].load(std::memory_order_relaxed)) / float(count);
+        return true;
+    }
+    return false;
+}
+
+void RadianceCache::Update(const glm::vec3& p, const glm::vec3& n, const glm::vec3& L, uint32_t layer) {
+    if (!cells) return;
+    if (!(L.r >= 0.0f && L.g >= 0.0f && L.b >= 0.0f)) return; // Reject NaNs
+    uint64_t key = CellKey(p, n, layer);
+    uint64_t h = MixHash(key);
+    for (uint32_t i = 0; i < RADIANCE_CACHE_PROBES; i++) {
+        Cell& cell = cells[(h + i) & (RADIANCE_CACHE_CELLS - 1)];
+        uint64_t k = cell.key.load(std::memory_order_acquire);
+        if (k == 0) {
+            uint64_t expected = 0;
+            if (cell.key.compare_exchange_strong(expected, key, std::memory_order_acq_rel)) {
+                occupied.fetch_add(1, std::memory_order_relaxed);
+                k = key;
+            }
+            else k = expected;
+        }
+        if (k != key) continue;
+        AtomicAdd(cell.sum[0], L.r);
+        AtomicAdd(cell.sum[1], L.g);
+        AtomicAdd(cell.sum[2], L.b);
+        cell.count.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    // Probe sequence full, drop the sample
+}
@@ -5,6 +5,22 @@
 #include "scene.h"
 #include "shading.h"
 #include "pbrtloader.h"
+#include "camerapath.h"
+#include "assetcache.h"
+#include "texturecache.h"
+
+#include <cstring>
+#include <fstream>
+
+// Rays traced by the calling thread, closest hit and shadow, for Mrays/s
+static thread_local uint64_t threadRays = 0;
+
+// Scene and TLAS of the view the calling thread renders, bound per tile by BindView
+static thread_local const Scene* threadScene = nullptr;
+static thread_local const TLAS* threadTLAS = nullptr;
+// Radiance cache layer of that scene, frames with their own scene do not share radiance
+static thread_local uint32_t threadCacheLayer = 0;
+static_assert(ANIM_BATCH_MAX < RADIANCE_CACHE_LAYERS, "every batch scene needs its own radiance cache layer");
 
 Renderer::Renderer() {
     scene = std::make_unique<Scene>();
@@ -16,21 +32,46 @@ Renderer::Renderer() {
     if(!envMap.Load()) {
         std::cerr << "Failed to load environment map: " << envMapFile << std::endl;
     }
+    threadPool = std::make_unique<RenderThreadPool>(static_cast<int>(NTHREADS));
+    controlThread = std::thread(&Renderer::ControlLoop, this);
+    watcher = std::make_unique<FileWatcher>([this](const std::vector<std::string>& changed) {
+        Submit(RenderJob::HotReload, "", changed);
+    });
 }
 
 Renderer::~Renderer() {
+    watcher.reset(); // Stops hot reload requests before the control thread goes
+    {
+        std::lock_guard<std::mutex> lock(controlMutex);
+        CancelLocked();
+        controlShutdown = true;
+    }
+    controlCv.notify_all();
+    controlThread.join();
     // scene.reset();
 }
 
 bool Renderer::SetPbrtScene(minipbrt::Scene* scene) {
+    LoadedScene loaded;
+    if (!ConvertPbrtScene(scene, loaded)) return false;
+    this->pbrtScene = loaded.pbrtScene;
+    this->scene = std::move(loaded.scene);
+    sceneId++;
+    AssetCache::Get().Trim(); // Assets only the old scene used can go now
+    return true;
+}
+
+// Builds the render scene (meshes, BVHs, textures) without touching the renderer,
+// so it can run on a loader thread while another frame renders
+bool Renderer::ConvertPbrtScene(minipbrt::Scene* scene, LoadedScene& out) {
     if (!scene) {
         std::cerr << "Error: Cannot set null PBRT scene" << std::endl;
         return false;
     }
     
     try {
-        this->pbrtScene = scene;
-        this->scene = std::make_unique<Scene>(
+        out.pbrtScene = scene;
+        out.scene = std::make_unique<Scene>(
             PbrtConverter::ConvertScene(scene)
         );
         return true;
@@ -70,12 +111,76 @@ void Renderer::PrintStats() {
     std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Samples per pixel"
         << c(RST) << c(DIM) << ": " << c(RST)
         << c(NUM) << spp << c(RST) << "\n";
+    std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Progressive passes"
+        << c(RST) << c(DIM) << ": " << c(RST)
+        << c(NUM) << passes << c(RST) << "\n";
     std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Indirect lighting"
         << c(RST) << c(DIM) << ": " << c(RST)
         << yn(indirectLighting) << "\n";
+    std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Max depth"
+        << c(RST) << c(DIM) << ": " << c(RST)
+        << c(NUM) << maxDepth << c(RST) << "\n";
+    std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Threads"
+        << c(RST) << c(DIM) << ": " << c(RST)
+        << c(NUM) << (renderThreads > 0 ? renderThreads : static_cast<int>(NTHREADS)) << c(RST) << "\n";
+    std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Thread pinning"
+        << c(RST) << c(DIM) << ": " << c(RST)
+        << yn(pinThreads) << "\n";
+    std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "NUMA nodes"
+        << c(RST) << c(DIM) << ": " << c(RST)
+        << c(NUM) << (numaNodes > 0 ? std::to_string(numaNodes) + " (emulated)" : std::string("detect")) << c(RST)
+        << c(DIM) << (numaReplicate ? ", replicated scene" : "") << c(RST) << "\n";
+    std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Wavefront"
+        << c(RST) << c(DIM) << ": " << c(RST)
+        << yn(wavefront) << "\n";
+    std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Stereo"
+        << c(RST) << c(DIM) << ": " << c(RST)
+        << yn(renderStereo) << "\n";
+    if (renderStereo) {
+        const char* outputs[] = { "Anaglyph", "Side by side", "Separate files" };
+        std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Stereo output"
+            << c(RST) << c(DIM) << ": " << c(RST)
+            << c(NUM) << outputs[static_cast<int>(stereoOutput)] << c(RST) << "\n";
+    }
     std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "MIS"
         << c(RST) << c(DIM) << ": " << c(RST)
         << yn(misEnabled) << "\n";
+    std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "RIS direct lighting"
+        << c(RST) << c(DIM) << ": " << c(RST)
+        << yn(risDirect) << "\n";
+    if (risDirect) {
+        std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "RIS candidates"
+            << c(RST) << c(DIM) << ": " << c(RST)
+            << c(NUM) << risCandidates << c(RST) << "\n";
+        std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "RIS temporal reuse"
+            << c(RST) << c(DIM) << ": " << c(RST)
+            << yn(risTemporalReuse) << "\n";
+        std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "RIS spatial reuse"
+            << c(RST) << c(DIM) << ": " << c(RST)
+            << yn(risSpatialReuse) << "\n";
+    }
+    std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Radiance cache"
+        << c(RST) << c(DIM) << ": " << c(RST)
+        << yn(radianceCacheEnabled) << "\n";
+    if (radianceCacheEnabled) {
+        std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Cache cell size"
+            << c(RST) << c(DIM) << ": " << c(RST)
+            << c(NUM) << cacheCellSize << c(RST) << "\n";
+        std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Bounces before lookup"
+            << c(RST) << c(DIM) << ": " << c(RST)
+            << c(NUM) << cacheMaxBounces << c(RST) << "\n";
+    }
+    std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Denoiser"
+        << c(RST) << c(DIM) << ": " << c(RST)
+        << yn(denoise) << "\n";
+    if (denoise) {
+        std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Filter iterations"
+            << c(RST) << c(DIM) << ": " << c(RST)
+            << c(NUM) << denoiseIterations << c(RST) << "\n";
+    }
+    std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Hot reload"
+        << c(RST) << c(DIM) << ": " << c(RST)
+        << yn(hotReload) << "\n";
     std::cout << "\n" << c(BLD) << c(SEC) << "Scene Statistics" << c(RST) << "\n";
     std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Number of shapes"
         << c(RST) << c(DIM) << ": " << c(RST)
@@ -98,6 +203,29 @@ void Renderer::PrintStats() {
     std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Number of materials"
         << c(RST) << c(DIM) << ": " << c(RST)
         << c(NUM) << scene->materials.size() << c(RST) << "\n";
+    AssetCache::Stats assets = AssetCache::Get().GetStats();
+    std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Asset cache"
+        << c(RST) << c(DIM) << ": " << c(RST)
+        << c(NUM) << assets.entries << c(RST) << c(DIM) << " assets, " << c(RST)
+        << c(NUM) << (assets.bytes >> 20) << " / " << (assets.capacity >> 20) << c(RST) << c(DIM) << " MB" << c(RST) << "\n";
+    std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Asset cache hits"
+        << c(RST) << c(DIM) << ": " << c(RST)
+        << c(NUM) << assets.hits << c(RST) << c(DIM) << " hits, " << c(RST)
+        << c(NUM) << assets.misses << c(RST) << c(DIM) << " misses, " << c(RST)
+        << c(NUM) << assets.evictions << c(RST) << c(DIM) << " evictions" << c(RST) << "\n";
+#if TEXTURE_CACHE
+    TextureCache::Stats textures = TextureCache::Get().GetStats();
+    double tileHitRate = textures.lookups > 0 ? 100.0 * double(textures.lookups - std::min(textures.misses, textures.lookups)) / double(textures.lookups) : 0.0;
+    std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Texture cache"
+        << c(RST) << c(DIM) << ": " << c(RST)
+        << c(NUM) << (textures.bytes >> 20) << " / " << (textures.capacity >> 20) << c(RST) << c(DIM) << " MB, " << c(RST)
+        << c(NUM) << (textures.bytesRead >> 20) << c(RST) << c(DIM) << " MB read" << c(RST) << "\n";
+    std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Texture cache hits"
+        << c(RST) << c(DIM) << ": " << c(RST)
+        << c(NUM) << std::fixed << std::setprecision(2) << tileHitRate << "%" << std::defaultfloat << c(RST) << c(DIM) << " of " << c(RST)
+        << c(NUM) << textures.lookups << c(RST) << c(DIM) << " tile lookups, " << c(RST)
+        << c(NUM) << textures.microMisses << c(RST) << c(DIM) << " micro-cache misses" << c(RST) << "\n";
+#endif
     std::cout << c(LINE) << "==================================================" << c(RST) << "\n";
 }
 
@@ -113,8 +241,27 @@ bool Renderer::SaveImage() {
     }
     
     auto fullPath = (std::filesystem::path(imgOutPath) / imgName).string();
-    
-    OIIO::ImageSpec spec(renderWidth, renderHeight, 3, OIIO::TypeDesc::UINT8);
+    bool splitEyes = renderStereo && stereoOutput == StereoOutput::SeparateFiles && displayWidth == 2 * renderWidth;
+    return WriteFrame(fullPath, renderBuffer.data(), displayWidth, renderHeight, splitEyes);
+}
+
+// Writes a display buffer. With splitEyes its left and right halves go to separate files,
+// named <name>_left and <name>_right.
+bool Renderer::WriteFrame(const std::string& fullPath, const uint8_t* pixels, int width, int height, bool splitEyes) {
+    if (!splitEyes) return WriteImage(fullPath, pixels, width, height, width * 3);
+    std::filesystem::path path(fullPath);
+    const int eyeWidth = width / 2;
+    const char* suffix[2] = { "_left", "_right" };
+    for (int view = 0; view < 2; view++) {
+        auto eyePath = (path.parent_path() / (path.stem().string() + suffix[view] + path.extension().string())).string();
+        if (!WriteImage(eyePath, pixels + view * eyeWidth * 3, eyeWidth, height, width * 3)) return false;
+    }
+    return true;
+}
+
+// Writes 8 bit RGB rows of rowBytes each
+bool Renderer::WriteImage(const std::string& fullPath, const uint8_t* src, int width, int height, int rowBytes) {
+    OIIO::ImageSpec spec(width, height, 3, OIIO::TypeDesc::UINT8);
     auto out = OIIO::ImageOutput::create(fullPath);
     if (!out) {
         std::cerr << "SaveImage error (create): " << OIIO::geterror() << std::endl;
@@ -125,9 +272,8 @@ bool Renderer::SaveImage() {
         return false;
     }
     
-	const uint8_t* src = renderBuffer.data();
 	bool writeSuccess = true;
-	writeSuccess = out->write_image(OIIO::TypeDesc::UINT8, src);
+	writeSuccess = out->write_image(OIIO::TypeDesc::UINT8, src, OIIO::AutoStride, rowBytes);
     
     if (!writeSuccess) {
         std::cerr << "SaveImage error (write): " << out->geterror() << std::endl;
@@ -141,7 +287,7 @@ bool Renderer::SaveImage() {
 }
 
 // Render all animation frames (.pbrt scenes) in a folder
-void Renderer::RenderAnimation() {
+bool Renderer::RenderAnimation() {
     auto rs = gui->GetRenderSettings();
     strncpy(animPath, rs.animPath, sizeof(animPath) - 1);
     animPath[sizeof(animPath) - 1] = '\0';
@@ -156,7 +302,7 @@ void Renderer::RenderAnimation() {
     int ct = sceneFiles.size();
     if (ct == 0) {
         std::cout << "No PBRT scenes found in path: " << animPath << std::endl;
-        return;
+        return false;
     }
     std::cout << "Found " << ct << " PBRT scenes in path: " << animPath << std::endl;
     std::cout << "Rendering animation ..." << std::endl;
@@ -165,112 +311,889 @@ void Renderer::RenderAnimation() {
         int numB = std::stoi(std::filesystem::path(b).stem().string());
         return numA < numB;
         });
-    int i = 1;
-    for (const auto& sceneFile : sceneFiles) {
-        std::cout << "Rendering frame: " << i << " out of: " << ct << std::endl;
-        strncpy(scenePath, sceneFile.c_str(), sizeof(scenePath) - 1);
+    // Frame pipeline: while frame i renders, frame i + 1 is loaded on a loader thread and
+    // finished frames are encoded by the frame writer's I/O thread
+    FrameWriter writer;
+    // Consecutive frames are batched, all frames of a batch render as views of a single tile
+    // job and share the pool by work stealing. Frames that differ from the batch's first only
+    // by their camera load just the camera, the others load and render their own scene.
+    std::vector<std::vector<int>> batches;
+    const int batchSize = rs.renderStereo ? 1 : AnimationBatchSize(rs);
+    std::vector<size_t> bodies(ct, 0);
+    if (batchSize > 1) {
+        for (int f = 0; f < ct; f++) bodies[f] = SceneBodyHash(sceneFiles[f]);
+    }
+    for (int f = 0; f < ct; f++) {
+        if (!batches.empty() && static_cast<int>(batches.back().size()) < batchSize) batches.back().push_back(f);
+        else batches.push_back({ f });
+    }
+    if (batches.size() < sceneFiles.size()) {
+        std::cout << "Rendering " << ct << " frames in " << batches.size() << " batches of up to " << batchSize << std::endl;
+    }
+
+    auto load = [&sceneFiles, &bodies](const std::vector<int>& frames) {
+        LoadedScene loaded;
+        if (!LoadSceneFile(sceneFiles[frames[0]], loaded)) {
+            loaded.scene.reset();
+            return loaded;
+        }
+        for (size_t k = 1; k < frames.size(); k++) {
+            const int f = frames[k];
+            std::unique_ptr<Camera> camera;
+            LoadedScene own;
+            if (bodies[f] != 0 && bodies[f] == bodies[frames[0]]) {
+                if (!LoadCamera(sceneFiles[f], camera)) {
+                    loaded.scene.reset();
+                    return loaded;
+                }
+            }
+            else {
+                if (!LoadSceneFile(sceneFiles[f], own) || !own.scene->camera) {
+                    loaded.scene.reset();
+                    return loaded;
+                }
+                delete own.pbrtScene; // Only the installed scene is edited, converted objects keep copies
+            }
+            loaded.cameras.push_back(std::move(camera));
+            loaded.scenes.push_back(std::move(own.scene));
+        }
+        return loaded;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration loadWait(0);
+    bool completed = true;
+    std::future<LoadedScene> next = std::async(std::launch::async, load, batches[0]);
+    for (size_t b = 0; b < batches.size(); b++) {
+        const std::vector<int>& frames = batches[b];
+        auto waitStart = std::chrono::steady_clock::now();
+        LoadedScene loaded = next.get();
+        loadWait += std::chrono::steady_clock::now() - waitStart;
+        if (b + 1 < batches.size()) next = std::async(std::launch::async, load, batches[b + 1]);
+        if (!loaded.scene) {
+            std::cerr << "Failed to load frame: " << sceneFiles[frames[0]] << std::endl;
+            completed = false;
+            break;
+        }
+        if (Cancelled() || writer.Failed()) {
+            completed = false;
+            break;
+        }
+
+        const int first = frames.front() + 1, last = frames.back() + 1;
+        if (first == last) std::cout << "Rendering frame: " << first << " out of: " << ct << std::endl;
+        else std::cout << "Rendering frames: " << first << "-" << last << " out of: " << ct << std::endl;
+        strncpy(scenePath, sceneFiles[frames[0]].c_str(), sizeof(scenePath) - 1);
         scenePath[sizeof(scenePath) - 1] = '\0';
-        BeginRender();
-        threadPool->frameFinished = false;
-        while (!threadPool->frameFinished) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        }
-        std::cout << "Finished rendering frame: " << i << std::endl;
-        std::string fName = std::to_string(i) + ".png";
-        strncpy(imgName, fName.c_str(), sizeof(imgName) - 1);
-        imgName[sizeof(imgName) - 1] = '\0';
-        strncpy(imgOutPath, animSavePath, sizeof(imgOutPath) - 1);
-        imgOutPath[sizeof(imgOutPath) - 1] = '\0';
-        std::cout << "Saving image ..." << std::endl;
-        if (SaveImage()) {
-            std::cout << "Saved image " << fName << " successfully." << std::endl;
+        pbrtScene = loaded.pbrtScene;
+        scene = std::move(loaded.scene);
+        sceneId++;
+        batchCameras = std::move(loaded.cameras);
+        batchScenes.clear();
+        for (auto& own : loaded.scenes) {
+            batchScenes.emplace_back(own ? std::make_unique<BatchScene>() : nullptr);
+            if (own) batchScenes.back()->scene = std::move(own);
         }
-        else {
-            std::cout << "Failed to save image " << fName << "." << std::endl;
-            return;
+        AssetCache::Get().Trim();
+        if (!RenderScene(rs)) {
+            completed = false;
+            break;
+        }
+        std::cout << "Finished rendering frame" << (first == last ? ": " : "s: ") << last << std::endl;
+
+        QueueFrames(writer, frames);
+    }
+    batchCameras.clear();
+    batchScenes.clear();
+    if (next.valid()) next.wait(); // Loads cannot be interrupted
+    completed = writer.Finish() && completed;
+
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    auto waitMs = std::chrono::duration_cast<std::chrono::milliseconds>(loadWait).count();
+    std::cout << "Animation " << (completed ? "finished" : "stopped") << " in " << ms << " ms, "
+              << waitMs << " ms spent waiting for scene loads" << std::endl;
+    return completed;
+}
+
+// Renders the frames of a camera path file (see camerapath.h) through the current scene,
+// which is loaded once. Frames are batched like animation frames.
+bool Renderer::RenderCameraPath() {
+    auto rs = gui->GetRenderSettings();
+    strncpy(animSavePath, rs.saveAnimPath, sizeof(animSavePath) - 1);
+    animSavePath[sizeof(animSavePath) - 1] = '\0';
+    if (!LoadScene(scenePath)) {
+        std::cerr << "Failed to load scene" << std::endl;
+        return false;
+    }
+    if (!scene->camera) {
+        std::cerr << "Scene has no supported camera" << std::endl;
+        return false;
+    }
+    const bool mirrored = glm::determinant(glm::mat3(scene->camera->GetCameraToWorld())) < 0.0f;
+    std::vector<glm::mat4> keyframes;
+    if (!CameraPath::Load(rs.cameraPath, mirrored, keyframes)) return false;
+    const int ct = static_cast<int>(keyframes.size());
+    const int batchSize = rs.renderStereo ? 1 : AnimationBatchSize(rs);
+    std::cout << "Rendering " << ct << " camera path frames in batches of up to " << batchSize << std::endl;
+
+    FrameWriter writer;
+    auto start = std::chrono::steady_clock::now();
+    bool completed = true;
+    for (int f = 0; f < ct; f += batchSize) {
+        if (Cancelled() || writer.Failed()) {
+            completed = false;
+            break;
+        }
+        std::vector<int> frames;
+        for (int k = f; k < std::min(ct, f + batchSize); k++) frames.push_back(k);
+        scene->camera->SetCameraToWorld(keyframes[f]);
+        batchCameras.clear();
+        batchScenes.clear();
+        for (size_t k = 1; k < frames.size(); k++) {
+            batchCameras.push_back(scene->camera->Clone());
+            batchCameras.back()->SetCameraToWorld(keyframes[frames[k]]);
+        }
+
+        const int first = frames.front() + 1, last = frames.back() + 1;
+        if (first == last) std::cout << "Rendering frame: " << first << " out of: " << ct << std::endl;
+        else std::cout << "Rendering frames: " << first << "-" << last << " out of: " << ct << std::endl;
+        if (!RenderScene(rs)) {
+            completed = false;
+            break;
         }
-        std::cout << std::endl;
-        i++;
+        QueueFrames(writer, frames);
+    }
+    batchCameras.clear();
+    completed = writer.Finish() && completed;
+
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Camera path " << (completed ? "finished" : "stopped") << " in " << ms << " ms, "
+              << ms / std::max(ct, 1) << " ms per frame" << std::endl;
+    return completed;
+}
+
+// Hands the display images of the rendered frames to the writer, named <frame + 1>.png.
+// Batched frames are stacked in the display buffer, one image each.
+void Renderer::QueueFrames(FrameWriter& writer, const std::vector<int>& frames) {
+    const size_t framePixels = size_t(displayWidth) * renderHeight * 3;
+    const bool splitEyes = renderStereo && stereoOutput == StereoOutput::SeparateFiles;
+    for (size_t k = 0; k < frames.size(); k++) {
+        auto path = (std::filesystem::path(animSavePath) / (std::to_string(frames[k] + 1) + ".png")).string();
+        std::vector<uint8_t> pixels(renderBuffer.begin() + k * framePixels, renderBuffer.begin() + (k + 1) * framePixels);
+        writer.Push(path, std::move(pixels), displayWidth, renderHeight, splitEyes);
     }
 }
 
-void Renderer::BeginRender() {
-    if (threadPool) threadPool->Stop();
+Renderer::FrameWriter::FrameWriter() : queue(ANIM_ENCODE_QUEUE) {
+    thread = std::thread([this]() {
+        Job job;
+        while (queue.Pop(job)) {
+            if (WriteFrame(job.path, job.pixels.data(), job.width, job.height, job.splitEyes)) {
+                std::cout << "Saved image " << std::filesystem::path(job.path).filename().string() << " successfully." << std::endl;
+            }
+            else {
+                std::cout << "Failed to save image " << job.path << "." << std::endl;
+                failed = true;
+            }
+        }
+    });
+}
+
+void Renderer::FrameWriter::Push(const std::string& path, std::vector<uint8_t> pixels, int width, int height, bool splitEyes) {
+    queue.Push({ path, std::move(pixels), width, height, splitEyes });
+}
+
+bool Renderer::FrameWriter::Finish() {
+    queue.Close();
+    if (thread.joinable()) thread.join();
+    return !failed;
+}
+
+// Returns true once the frame is done, false if loading failed or the render was cancelled
+bool Renderer::BeginRender() {
     std::cout << "Starting render ..." << std::endl;
     auto rs = gui->GetRenderSettings();
     if (!LoadScene(scenePath)) {
         std::cerr << "Failed to reload scene" << std::endl;
-        return;
+        return false;
+    }
+    if (Cancelled()) return false;
+    WatchSceneFiles(rs.hotReload);
+    return RenderScene(rs, true);
+}
+
+// Re-renders the frame once watched files changed. Edits of the scene file that keep its
+// structure are applied in place, anything else loads the scene again, which takes the
+// meshes, BLASes and textures that did not change from the asset cache.
+bool Renderer::HotReload(const std::vector<std::string>& changedFiles) {
+    auto start = std::chrono::steady_clock::now();
+    const std::string scene = FileWatcher::NormalizedPath(scenePath);
+    bool sceneOnly = true;
+    for (const std::string& file : changedFiles) {
+        std::cout << "Hot reload: " << file << " changed" << std::endl;
+        sceneOnly = sceneOnly && file == scene;
+    }
+    if (!sceneOnly || !ApplySceneEdits()) {
+        std::cout << "Hot reload: loading the scene again" << std::endl;
+        return BeginRender();
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Hot reload: scene edits applied in " << ms << " ms" << std::endl;
+    if (Cancelled()) return false;
+    auto rs = gui->GetRenderSettings();
+    WatchSceneFiles(rs.hotReload);
+    return RenderScene(rs, true);
+}
+
+// Same shapes, mesh files, material and light types and assignments: edits of such a scene
+// can be applied to the loaded one without building anything
+static bool SameStructure(const minipbrt::Scene& a, const minipbrt::Scene& b) {
+    if (a.shapes.size() != b.shapes.size() || a.materials.size() != b.materials.size() ||
+        a.areaLights.size() != b.areaLights.size() || a.lights.size() != b.lights.size()) return false;
+    if (!a.camera || !b.camera || a.camera->type() != b.camera->type()) return false;
+    for (size_t i = 0; i < a.shapes.size(); i++) {
+        const minipbrt::Shape* sa = a.shapes[i];
+        const minipbrt::Shape* sb = b.shapes[i];
+        if (sa->type() != sb->type() || sa->material != sb->material || sa->areaLight != sb->areaLight) return false;
+        if (sa->type() == minipbrt::ShapeType::PLYMesh &&
+            std::strcmp(static_cast<const minipbrt::PLYMesh*>(sa)->filename, static_cast<const minipbrt::PLYMesh*>(sb)->filename) != 0) return false;
+        if (sa->type() == minipbrt::ShapeType::Sphere &&
+            static_cast<const minipbrt::Sphere*>(sa)->radius != static_cast<const minipbrt::Sphere*>(sb)->radius) return false;
+    }
+    for (size_t i = 0; i < a.materials.size(); i++) {
+        if (!a.materials[i] != !b.materials[i]) return false;
+        if (a.materials[i] && a.materials[i]->type() != b.materials[i]->type()) return false;
+    }
+    for (size_t i = 0; i < a.areaLights.size(); i++) {
+        if (a.areaLights[i]->type() != b.areaLights[i]->type()) return false;
     }
+    for (size_t i = 0; i < a.lights.size(); i++) {
+        if (a.lights[i]->type() != b.lights[i]->type()) return false;
+    }
+    return true;
+}
+
+// Parses the scene file again and applies its material and light parameters, shape transforms
+// and camera to the loaded scene. False when the edit needs a full load instead.
+bool Renderer::ApplySceneEdits() {
+    PbrtLoader pbrtLoader;
+    if (!pbrtScene || !scene || !pbrtLoader.LoadScene(scenePath)) return false;
+    std::unique_ptr<minipbrt::Scene> edited(pbrtLoader.GetScene());
+    if (!SameStructure(*pbrtScene, *edited)) return false;
+    std::unique_ptr<Camera> camera(PbrtConverter::ConvertCamera(edited->camera));
+    if (!camera) return false;
+
+    int materials = 0, lights = 0, transforms = 0;
+    for (size_t i = 0; i < edited->materials.size(); i++) {
+        std::unique_ptr<Material> material(PbrtConverter::ConvertMaterial(edited->materials[i]));
+        if (material && scene->materials[i] && scene->materials[i]->CopyParameters(*material)) materials++;
+    }
+
+    // Converted lights are stored area lights first, skipping unsupported types
+    size_t lightIdx = 0;
+    auto copyLight = [&](Light* converted) {
+        std::unique_ptr<Light> light(converted);
+        if (!light || lightIdx >= scene->lights.size()) return;
+        if (scene->lights[lightIdx++]->CopyParameters(*light)) lights++;
+    };
+    for (auto pbrtAreaLight : edited->areaLights) copyLight(PbrtConverter::ConvertAreaLight(pbrtAreaLight));
+    for (auto pbrtLight : edited->lights) copyLight(PbrtConverter::ConvertIdealLight(pbrtLight));
+
+    // Moved shapes only refit the TLAS when the frame launches
+    size_t shapeIdx = 0;
+    for (auto pbrtShape : edited->shapes) {
+        if (pbrtShape->type() != minipbrt::ShapeType::Sphere && pbrtShape->type() != minipbrt::ShapeType::PLYMesh) continue; // Not converted
+        if (shapeIdx >= scene->shapes.size()) break;
+        Shape* shape = scene->shapes[shapeIdx++];
+        glm::mat4 transform = PbrtConverter::TransformToMat4(pbrtShape->shapeToWorld);
+        if (transform != shape->GetTransform()) {
+            shape->SetTransform(transform);
+            transforms++;
+        }
+    }
+
+    bool cameraMoved = !scene->camera || camera->GetCameraToWorld() != scene->camera->GetCameraToWorld();
+    delete scene->camera;
+    scene->camera = camera.release();
+    delete pbrtScene; // Converted objects keep copies of its values
+    pbrtScene = edited.release();
+    sceneId++; // Parameter edits made in the GUI before the file changed are dropped
+
+    std::cout << "Hot reload: " << materials << " materials, " << lights << " lights, "
+              << transforms << " transforms changed" << (cameraMoved ? ", camera moved" : "") << std::endl;
+    return true;
+}
+
+// Hands the scene file and the mesh and texture files it uses to the watcher, or stops
+// watching when hot reload is off
+void Renderer::WatchSceneFiles(bool enabled) {
+    std::vector<std::string> files;
+    if (enabled && scene) {
+        files.push_back(scenePath);
+        for (Shape* shape : scene->shapes) {
+            auto mesh = dynamic_cast<TriangleMesh*>(shape);
+            if (!mesh) continue;
+            files.push_back(mesh->GetPath());
+            for (const std::string& texture : mesh->GetTexturePaths()) files.push_back(texture);
+        }
+    }
+    watcher->Watch(files);
+}
+
+// Renders the loaded scene with the given settings. With live edits the GUI gets the scene's
+// parameters, edits made while the frame renders restart its accumulation.
+bool Renderer::RenderScene(const RenderSettings& rs, bool liveEdits) {
+    ApplyRenderSettings(rs);
+    PrepareFrame();
+    PrintStats();
+    if (liveEdits && gui) gui->SetSceneParams(CollectSceneParams());
+    return LaunchFrame(liveEdits);
+}
+
+// Renders edits that arrived while no frame was rendering. Lighting and materials only, the
+// frame is rendered again as it was prepared, with no loading or BVH work.
+bool Renderer::RenderEdits() {
+    if (!scene || film.empty()) return false;
+    auto start = std::chrono::steady_clock::now();
+    if (!ApplySceneParams()) return true; // Edits of a scene since replaced
+    ResetAccumulation();
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Scene edits applied in " << us << " us" << std::endl;
+    return RenderPasses(true);
+}
+
+// Parameters of the installed scene's materials and lights, as the GUI edits them
+SceneParams Renderer::CollectSceneParams() const {
+    SceneParams params;
+    params.sceneId = sceneId;
+    auto toArray = [](const glm::vec3& v, float* out) { out[0] = v.x; out[1] = v.y; out[2] = v.z; };
+    for (const Material* material : scene->materials) {
+        MaterialParams m;
+        if (auto matte = dynamic_cast<const MatteMaterial*>(material)) {
+            m.type = MaterialParams::Type::Matte;
+            toArray(matte->albedo, m.albedo);
+        }
+        else if (auto disney = dynamic_cast<const DisneyMaterial*>(material)) {
+            m.type = MaterialParams::Type::Disney;
+            toArray(disney->albedo, m.albedo);
+            m.roughness = disney->roughness;
+            m.metallic = disney->metallic;
+            m.eta = disney->eta;
+            m.textured = disney->albedoTexture != nullptr;
+        }
+        params.materials.push_back(m);
+    }
+    for (const Light* light : scene->lights) {
+        LightParams l;
+        if (auto point = dynamic_cast<const PointLight*>(light)) {
+            l.type = LightParams::Type::Point;
+            toArray(point->GetIntensity(), l.color);
+            toArray(point->GetPosition(), l.position);
+        }
+        else if (auto area = dynamic_cast<const DiffuseAreaLight*>(light)) {
+            l.type = LightParams::Type::DiffuseArea;
+            toArray(area->GetEmission(), l.color);
+            l.twoSided = area->IsTwoSided();
+        }
+        params.lights.push_back(l);
+    }
+    return params;
+}
+
+// Copies the latest edits into the scene. Only called while no render thread runs, between
+// passes or before a frame. False when there were none for this scene.
+bool Renderer::ApplySceneParams() {
+    SceneParams params;
+    {
+        std::lock_guard<std::mutex> lock(editMutex);
+        if (!editsPending) return false;
+        params = std::move(pendingEdits);
+        editsPending = false;
+    }
+    if (params.sceneId != sceneId || !scene) return false;
+    auto toVec = [](const float* v) { return glm::vec3(v[0], v[1], v[2]); };
+    for (size_t i = 0; i < params.materials.size() && i < scene->materials.size(); i++) {
+        const MaterialParams& m = params.materials[i];
+        if (auto matte = dynamic_cast<MatteMaterial*>(scene->materials[i])) {
+            if (m.type == MaterialParams::Type::Matte) matte->albedo = toVec(m.albedo);
+        }
+        else if (auto disney = dynamic_cast<DisneyMaterial*>(scene->materials[i])) {
+            if (m.type != MaterialParams::Type::Disney) continue;
+            disney->albedo = toVec(m.albedo);
+            disney->roughness = m.roughness;
+            disney->metallic = m.metallic;
+            disney->eta = m.eta;
+        }
+    }
+    for (size_t i = 0; i < params.lights.size() && i < scene->lights.size(); i++) {
+        const LightParams& l = params.lights[i];
+        if (auto point = dynamic_cast<PointLight*>(scene->lights[i])) {
+            if (l.type != LightParams::Type::Point) continue;
+            point->SetIntensity(toVec(l.color));
+            point->SetPosition(toVec(l.position));
+        }
+        else if (auto area = dynamic_cast<DiffuseAreaLight*>(scene->lights[i])) {
+            if (l.type != LightParams::Type::DiffuseArea) continue;
+            area->SetEmission(toVec(l.color));
+            area->SetTwoSided(l.twoSided);
+        }
+    }
+    return true;
+}
+
+// Edits of the installed scene not yet applied
+bool Renderer::EditsWaiting() {
+    std::lock_guard<std::mutex> lock(editMutex);
+    return editsPending && pendingEdits.sceneId == sceneId;
+}
+
+// A frame in flight applies the edits before its next pass. An idle renderer renders them as
+// a job of their own, other jobs (loads, animations) are never interrupted by an edit.
+void Renderer::EditScene(const SceneParams& params) {
+    {
+        std::lock_guard<std::mutex> lock(editMutex);
+        pendingEdits = params;
+        editsPending = true;
+    }
+    bool idle;
+    {
+        std::lock_guard<std::mutex> lock(controlMutex);
+        idle = !controlBusy && !pendingRequest;
+    }
+    if (idle && params.sceneId == sceneId) Submit(RenderJob::SceneEdit, "");
+}
+
+void Renderer::ApplyRenderSettings(const RenderSettings& rs) {
     renderWidth = rs.width;
     renderHeight = rs.height;
     spp = rs.spp;
     indirectLighting = rs.indirect;
     misEnabled = rs.mis;
     renderLights = rs.renderLights;
+    hotReload = rs.hotReload;
     renderStereo = rs.renderStereo;
     envMapEnabled = rs.envMapEnabled;
     envMapIntensity = rs.envMapIntensity;
+    radianceCacheEnabled = rs.radianceCache;
+    cacheCellSize = rs.cacheCellSize;
+    cacheMaxBounces = rs.cacheMaxBounces;
+    risDirect = rs.risDirect;
+    risCandidates = rs.risCandidates;
+    risTemporalReuse = rs.risTemporalReuse;
+    risSpatialReuse = rs.risSpatialReuse;
+    maxDepth = rs.maxDepth;
+    wavefront = rs.wavefront;
+    renderThreads = rs.threads;
+    pinThreads = rs.pinThreads;
+    numaNodes = glm::max(0, rs.numaNodes);
+    numaReplicate = rs.numaReplicate;
+    AssetCache::Get().SetCapacity(size_t(std::max(rs.assetCacheMB, 0)) << 20);
+    TextureCache::Get().SetCapacity(size_t(std::max(rs.textureCacheMB, 0)) << 20);
+    tileSize = glm::max(1, rs.tileSize);
+    tileOrder = static_cast<TileOrder>(glm::clamp(rs.tileOrder, 0, 3));
+    pixelOrder = static_cast<TileOrder>(glm::clamp(rs.pixelOrder, 0, 3));
+    passes = glm::max(1, rs.passes);
+    denoise = rs.denoise;
+    denoiseIterations = glm::clamp(rs.denoiseIterations, 0, DENOISE_MAX_ITERATIONS);
     gammaCorrect = rs.gammaCorrect;
     tonemap = rs.tonemap;
     exposureBias = rs.exposureBias;
     stereoIPD = rs.stereoIPD;
-    renderBuffer.resize(renderWidth * renderHeight * 3, 0);
+    stereoOutput = static_cast<StereoOutput>(glm::clamp(rs.stereoOutput, 0, 2));
+}
+
+// Clears the buffers and per frame caches before rendering from scratch
+void Renderer::PrepareFrame() {
+    // Stereo renders both eyes in one job, each view is a camera offset along the right axis.
+    // An animation batch renders one view per frame, each with its own camera, and frames
+    // with a batch scene with that scene's camera.
+    if (!batchCameras.empty()) renderStereo = false;
+    views = renderStereo ? 2 : 1 + static_cast<int>(batchCameras.size());
+    viewCameras.assign(1, scene->camera);
+    for (size_t k = 0; k < batchCameras.size(); k++) {
+        const bool own = k < batchScenes.size() && batchScenes[k];
+        viewCameras.push_back(own ? batchScenes[k]->scene->camera : batchCameras[k].get());
+    }
+    viewOffsets.assign(views, glm::vec3(0.0f));
+    if (renderStereo) {
+        viewCameras.push_back(scene->camera);
+        glm::vec3 right = scene->camera->GetRight();
+        viewOffsets[0] = -right * (stereoIPD * 0.5f);
+        viewOffsets[1] = right * (stereoIPD * 0.5f);
+    }
+    displayWidth = renderStereo && stereoOutput != StereoOutput::Anaglyph ? 2 * renderWidth : renderWidth;
+
+    const size_t nPixels = size_t(renderWidth) * renderHeight * views;
+    const int displayImages = renderStereo ? 1 : views;
+    renderBuffer.resize(size_t(displayWidth) * renderHeight * displayImages * 3, 0);
     std::fill(renderBuffer.begin(), renderBuffer.end(), 0);
+    film.assign(nPixels, glm::vec3(0.0f));
+    albedoAOV.assign(nPixels, glm::vec3(0.0f));
+    normalAOV.assign(nPixels, glm::vec3(0.0f));
+    ResetAccumulation();
+}
+
+// Clears what the passes accumulate. The radiance cache and RIS reservoirs hold lighting of
+// the old parameters, so they start over with the film.
+void Renderer::ResetAccumulation() {
+    std::fill(film.begin(), film.end(), glm::vec3(0.0f));
+    std::fill(albedoAOV.begin(), albedoAOV.end(), glm::vec3(0.0f));
+    std::fill(normalAOV.begin(), normalAOV.end(), glm::vec3(0.0f));
+    if (radianceCacheEnabled) radianceCache.Reset(cacheCellSize);
+    if (risDirect && (risTemporalReuse || risSpatialReuse)) risReservoirs.assign(film.size(), Reservoir());
+    else risReservoirs.clear();
+    risPassReservoirs.clear();
+}
+
+// Camera ray through film position (x, y) of a view
+Ray Renderer::CameraRay(float x, float y, int view) const {
+    Ray ray = viewCameras[view]->GenerateRay(x, y, renderWidth, renderHeight);
+    ray.o += viewOffsets[view];
+    return ray;
+}
+
+// Renders the scene once for every tile size, tile order and pixel order and prints the
+// throughput of each combination. The scene is loaded once, other settings come from the GUI.
+bool Renderer::RunTilingSweep() {
+    auto rs = gui->GetRenderSettings();
+    if (!LoadScene(scenePath)) {
+        std::cerr << "Failed to load scene" << std::endl;
+        return false;
+    }
+    ApplyRenderSettings(rs);
+    renderStereo = false;
+    denoise = false; // Not part of the measurement
     PrintStats();
-    if (renderStereo) {
-        glm::vec3 originalPos = scene->camera->GetPosition();
-        glm::vec3 originalRight = scene->camera->GetRight();
-        std::cout << "Rendering left eye ..." << std::endl;
-        renderingLeftEye = true;
-        scene->camera->SetPosition(originalPos - originalRight * (stereoIPD * 0.5f));
-        threadPool = std::make_unique<RenderThreadPool>(scene.get(), NTHREADS, renderWidth, renderHeight);
-        threadPool->startTime = std::chrono::steady_clock::now();
-        threadPool->Start([this](int u, int v) { RenderPixel(u, v); });
-        while (!threadPool->frameFinished) {}
-        std::cout << "Left eye complete" << std::endl;
-        std::cout << "Rendering right eye ..." << std::endl;
-        renderingLeftEye = false;
-        scene->camera->SetPosition(originalPos + originalRight * (stereoIPD * 0.5f));
-        threadPool->Stop();
-        threadPool = std::make_unique<RenderThreadPool>(scene.get(), NTHREADS, renderWidth, renderHeight);
-        threadPool->startTime = std::chrono::steady_clock::now();
-        threadPool->Start([this](int u, int v) { RenderPixel(u, v); });
-        while (!threadPool->frameFinished) {}
-        std::cout << "Right eye complete" << std::endl;
-        scene->camera->SetPosition(originalPos);
+
+    struct SweepResult {
+        int tileSize;
+        TileOrder tileOrder, pixelOrder;
+        long long ms;
+        double mrays;
+    };
+    const int tileSizes[] = { 8, 16, 32, 64 };
+    const TileOrder orders[] = { TileOrder::Scanline, TileOrder::Spiral, TileOrder::Morton, TileOrder::Hilbert };
+    std::vector<SweepResult> results;
+    for (int size : tileSizes) {
+        for (TileOrder tOrder : orders) {
+            for (TileOrder pOrder : orders) {
+                tileSize = size;
+                tileOrder = tOrder;
+                pixelOrder = pOrder;
+                PrepareFrame();
+                threadPool->SetVerbose(false);
+                auto start = std::chrono::steady_clock::now();
+                bool completed = LaunchFrame();
+                auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+                if (!completed) {
+                    threadPool->SetVerbose(true);
+                    std::cout << "Tiling sweep stopped" << std::endl;
+                    return false;
+                }
+                double mrays = ns > 0 ? static_cast<double>(raysTraced.load()) * 1e3 / static_cast<double>(ns) : 0.0;
+                results.push_back({ size, tOrder, pOrder, ns / 1000000, mrays });
+            }
+        }
     }
-    else {
-        threadPool = std::make_unique<RenderThreadPool>(scene.get(), NTHREADS, renderWidth, renderHeight);
-        threadPool->startTime = std::chrono::steady_clock::now();
-        threadPool->Start([this](int u, int v) { RenderPixel(u, v); });
+    threadPool->SetVerbose(true);
+
+    size_t best = 0;
+    for (size_t i = 1; i < results.size(); i++) {
+        if (results[i].mrays > results[best].mrays) best = i;
+    }
+    std::cout << "\n  Tiling sweep (" << renderWidth << " x " << renderHeight << ", " << spp * passes << " spp)\n";
+    std::cout << "  " << std::left << std::setw(6) << "Tile" << std::setw(12) << "Tile order"
+              << std::setw(12) << "Pixel order" << std::right << std::setw(10) << "Time (ms)"
+              << std::setw(10) << "Mrays/s" << "\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const SweepResult& r = results[i];
+        std::cout << "  " << std::left << std::setw(6) << r.tileSize << std::setw(12) << TileOrderName(r.tileOrder)
+                  << std::setw(12) << TileOrderName(r.pixelOrder) << std::right << std::setw(10) << r.ms
+                  << std::setw(10) << std::fixed << std::setprecision(2) << r.mrays << std::defaultfloat
+                  << (i == best ? "  <- best" : "") << "\n";
+    }
+    std::cout << std::left << std::endl;
+    return true;
+}
+
+// Renders one frame on the persistent pool, blocking until it is done. False if cancelled.
+bool Renderer::LaunchFrame(bool liveEdits) {
+    int nThreads = renderThreads > 0 ? renderThreads : static_cast<int>(NTHREADS);
+    threadPool->Resize(nThreads);
+    Numa::Configure(numaNodes);
+    threadPool->SetPlacement(pinThreads);
+    UpdateAccelerationStructures();
+    ReplicateSceneData();
+    threadPool->SetTiling(tileSize, tileOrder, pixelOrder);
+    threadPool->ResetTileCosts();
+    return RenderPasses(liveEdits);
+}
+
+// Progressive passes accumulate into the film, the last one resolves it. With live edits, the
+// edits made during a pass are applied before the next one, which starts the film over.
+bool Renderer::RenderPasses(bool liveEdits) {
+    raysTraced = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    // One virtual call per tile, pixels are looped inside the kernel
+    struct FrameKernel : TileKernel {
+        Renderer* renderer;
+        explicit FrameKernel(Renderer* renderer) : renderer(renderer) {}
+        void RenderTile(const Tile& tile, TileSplitter& splitter) override {
+            uint64_t rays = threadRays;
+            renderer->BindView(tile.view);
+            if (renderer->wavefront) renderer->RenderTileWavefront(tile, splitter);
+            else renderer->RenderTileMegakernel(tile, splitter);
+            renderer->raysTraced.fetch_add(threadRays - rays, std::memory_order_relaxed);
+        }
+    } kernel(this);
+
+    for (int pass = 0; pass < passes; pass++) {
+        if (liveEdits && ApplySceneParams()) {
+            ResetAccumulation();
+            pass = 0;
+        }
+        // Spatial reuse reads the reservoirs of the previous passes only, which no thread writes
+        if (risSpatialReuse && !risReservoirs.empty()) risPassReservoirs = risReservoirs;
+        if (!threadPool->RenderTiles(renderWidth, renderHeight, views, pass * spp, (pass + 1) * spp, kernel)) return false;
+        if (pass == passes - 1 && !ResolveFilm()) return false;
+        if (liveEdits && pass == passes - 1 && EditsWaiting()) pass = -1; // Edited during the last pass
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    double mrays = static_cast<double>(raysTraced.load()) * 1e-6;
+    std::cout << "Traced " << std::fixed << std::setprecision(1) << mrays << " Mrays ("
+              << (ms > 0 ? mrays * 1e3 / ms : 0.0) << " Mrays/s)" << std::defaultfloat << std::endl;
+    return true;
+}
+
+// Brings the BLASes and the TLAS up to date with the installed scene. Unchanged meshes come
+// from the asset cache as they are, deformed ones are refit and moved shapes refit the TLAS,
+// so the work is proportional to what changed since the previous frame.
+void Renderer::UpdateAccelerationStructures() {
+    auto start = std::chrono::steady_clock::now();
+    int blasRefit = 0, blasRebuilt = 0;
+    std::vector<Bounds> bounds;
+    auto fit = [&](Scene& fitted, TLAS& fittedTlas) {
+        bounds.clear();
+        for (Shape* shape : fitted.shapes) {
+            if (auto mesh = dynamic_cast<TriangleMesh*>(shape)) mesh->UpdateBLAS(blasRefit, blasRebuilt);
+            bounds.push_back(shape->GetWorldBounds());
+        }
+        return fittedTlas.Fit(bounds);
+    };
+    TLAS::Update update = fit(*scene, tlas);
+    int batchTlases = 0;
+    for (auto& batch : batchScenes) {
+        if (!batch) continue;
+        fit(*batch->scene, batch->tlas);
+        batchTlases++;
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    const char* tlasUpdate[] = { "built", "refit", "rebuilt" };
+    std::cout << "TLAS " << tlasUpdate[static_cast<int>(update)] << " (SAH " << std::fixed << std::setprecision(2)
+              << tlas.SAHCost() << ", " << tlas.GetBuildCost() << " at build)" << std::defaultfloat;
+    if (blasRefit + blasRebuilt > 0) std::cout << ", BLAS " << blasRefit << " refit, " << blasRebuilt << " rebuilt";
+    if (batchTlases > 0) std::cout << ", " << batchTlases << " batch scene TLASes built";
+    std::cout << " in " << ms << " ms" << std::endl;
+}
+
+// Gives every NUMA node after the first its own copy of the mesh BVHs and attributes, made
+// by one thread per node bound to it so the pages are first touched there. Only submeshes
+// without a complete set of replicas are replicated; the replicas of deformed submeshes are
+// refit like their originals. Replicas last until the scene is reloaded or the node count changes.
+void Renderer::ReplicateSceneData() {
+    // Shared assets are referenced by several shapes, each submesh is replicated once
+    std::vector<SubMesh*> subMeshes;
+    auto collect = [&subMeshes](const Scene& replicated) {
+        for (Shape* shape : replicated.shapes) {
+            if (auto mesh = dynamic_cast<TriangleMesh*>(shape)) {
+                subMeshes.insert(subMeshes.end(), mesh->meshes.begin(), mesh->meshes.end());
+            }
+        }
+    };
+    collect(*scene);
+    for (const auto& batch : batchScenes) {
+        if (batch) collect(*batch->scene);
+    }
+    std::sort(subMeshes.begin(), subMeshes.end());
+    subMeshes.erase(std::unique(subMeshes.begin(), subMeshes.end()), subMeshes.end());
+
+    const int nodes = threadPool->GetNodeCount();
+    const size_t wanted = numaReplicate && nodes > 1 ? size_t(nodes - 1) : 0;
+    std::vector<SubMesh*> build, refit;
+    for (SubMesh* subMesh : subMeshes) {
+        bool complete = subMesh->replicas.size() == wanted;
+        for (const auto& replica : subMesh->replicas) complete = complete && replica;
+        if (!complete) {
+            if (subMesh->replicas.size() != wanted) {
+                subMesh->replicas.clear();
+                subMesh->replicas.resize(wanted);
+            }
+            if (wanted > 0) build.push_back(subMesh);
+        }
+        else if (subMesh->replicasStale && wanted > 0) refit.push_back(subMesh);
+        subMesh->replicasStale = false;
+    }
+    if (build.empty() && refit.empty()) return;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> builders;
+    for (int node = 1; node < nodes; node++) {
+        builders.emplace_back([&build, &refit, node]() {
+            Numa::BindCurrentThreadToNode(node);
+            for (SubMesh* subMesh : build) {
+                if (!subMesh->replicas[node - 1]) subMesh->BuildReplica(node);
+            }
+            for (SubMesh* subMesh : refit) subMesh->RefitReplica(node);
+        });
+    }
+    for (auto& t : builders) t.join();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Replicated " << build.size() << " submeshes and refit " << refit.size() << " on "
+              << nodes - 1 << " more NUMA nodes in " << ms << " ms" << std::endl;
+}
+
+// Render jobs run one at a time on the control thread. A new request cancels the job in
+// flight and replaces any request still waiting, only the latest one runs.
+std::shared_future<bool> Renderer::Submit(RenderJob job, const std::string& path, std::vector<std::string> changedFiles) {
+    // Only single frames reload, edits must not restart an animation or a sweep
+    if (job != RenderJob::Frame && job != RenderJob::HotReload) watcher->Watch({});
+    auto request = std::make_unique<RenderRequest>();
+    request->job = job;
+    request->scenePath = path;
+    request->changedFiles = std::move(changedFiles);
+    std::shared_future<bool> future = request->done.get_future().share();
+    {
+        std::lock_guard<std::mutex> lock(controlMutex);
+        CancelLocked();
+        pendingRequest = std::move(request);
+    }
+    controlCv.notify_all();
+    return future;
+}
+
+std::shared_future<bool> Renderer::StartRender(const std::string& path) {
+    return Submit(RenderJob::Frame, path);
+}
+
+std::shared_future<bool> Renderer::StartAnimation() {
+    return Submit(RenderJob::Animation, "");
+}
+
+std::shared_future<bool> Renderer::StartCameraPath(const std::string& path) {
+    return Submit(RenderJob::CameraPath, path);
+}
+
+std::shared_future<bool> Renderer::StartTilingSweep(const std::string& path) {
+    return Submit(RenderJob::TilingSweep, path);
+}
+
+// Drops the waiting request and flags the running job, which stops within one camera
+// sample (megakernel) or one bounce of a wave (wavefront) per thread. Needs controlMutex.
+void Renderer::CancelLocked() {
+    if (pendingRequest) {
+        pendingRequest->done.set_value(false);
+        pendingRequest.reset();
+    }
+    if (controlBusy && !cancelRequested) {
+        cancelRequested = true;
+        threadPool->RequestStop();
+        cancelTime = std::chrono::steady_clock::now();
     }
 }
 
+void Renderer::CancelRender() {
+    std::lock_guard<std::mutex> lock(controlMutex);
+    CancelLocked();
+}
+
+// Cancels and blocks until the control thread is idle
 void Renderer::StopRender() {
+    std::unique_lock<std::mutex> lock(controlMutex);
+    CancelLocked();
+    controlCv.wait(lock, [&] { return !controlBusy; });
+}
+
+void Renderer::ControlLoop() {
+    std::unique_lock<std::mutex> lock(controlMutex);
+    while (true) {
+        controlCv.wait(lock, [&] { return controlShutdown || pendingRequest; });
+        if (controlShutdown) break;
+        std::unique_ptr<RenderRequest> request = std::move(pendingRequest);
+        if (!request->scenePath.empty()) {
+            strncpy(scenePath, request->scenePath.c_str(), sizeof(scenePath) - 1);
+            scenePath[sizeof(scenePath) - 1] = '\0';
+        }
+        cancelRequested = false;
+        threadPool->Resume();
+        controlBusy = true;
+        lock.unlock();
+
+        bool completed = false;
+        switch (request->job) {
+        case RenderJob::Frame: completed = BeginRender(); break;
+        case RenderJob::Animation: completed = RenderAnimation(); break;
+        case RenderJob::CameraPath: completed = RenderCameraPath(); break;
+        case RenderJob::TilingSweep: completed = RunTilingSweep(); break;
+        case RenderJob::HotReload: completed = HotReload(request->changedFiles); break;
+        case RenderJob::SceneEdit: completed = RenderEdits(); break;
+        }
+
+        lock.lock();
+        if (cancelRequested) {
+            completed = false;
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - cancelTime).count();
+            std::cout << "Render cancelled, idle after " << ms << " ms" << std::endl;
+        }
+        controlBusy = false;
+        request->done.set_value(completed);
+        // Edits made after the frame stopped taking them, EditScene still saw it busy
+        if (!pendingRequest && !cancelRequested && EditsWaiting()) {
+            pendingRequest = std::make_unique<RenderRequest>();
+            pendingRequest->job = RenderJob::SceneEdit;
+        }
+        controlCv.notify_all();
+    }
+}
+
+// Points the calling thread's ray queries at the scene of a view: a batched frame's own scene
+// if it has one, the installed scene otherwise. Views of the installed scene share radiance
+// cache layer 0, a batch scene has the layer of its view, as its objects may have moved.
+void Renderer::BindView(int view) {
+    const BatchScene* batch = view > 0 && view <= static_cast<int>(batchScenes.size()) ? batchScenes[view - 1].get() : nullptr;
+    threadScene = batch ? batch->scene.get() : scene.get();
+    threadTLAS = batch ? &batch->tlas : &tlas;
+    threadCacheLayer = batch ? static_cast<uint32_t>(view) : 0;
 }
 
 bool Renderer::Occluded(const glm::vec3& p, const glm::vec3& wi, const glm::vec3& n, float maxDist) const {
+    threadRays++;
     HitInfo hit;
     Ray shadowRay = Ray(p + n * OCCLUDED_EPS, wi);
-    for(Shape* shape : scene->shapes) {
-        if(shape->IsAreaLight()) continue;
+    bool occluded = false;
+    threadTLAS->Traverse(shadowRay, maxDist, [&](uint32_t s) {
+        Shape* shape = threadScene->shapes[s];
+        if(shape->IsAreaLight()) return maxDist;
         Ray rObj = shadowRay.Transform(shape->GetInverseTransform());
         HitInfo hit;
         if(shape->IntersectRay(rObj, hit)) {
             if (hit.front && hit.t < maxDist) {
-                return true;
+                occluded = true;
+                return -1.0f;
             }
         }
-    }
-    return false;
+        return maxDist;
+    });
+    return occluded;
 }
 
 bool Renderer::TraceRay(const Ray& ray, HitInfo& hit) const {
+    threadRays++;
     bool hitAny = false;
     float closest = FLT_MAX;
     
-    for (Shape* shape : scene->shapes) {
+    threadTLAS->Traverse(ray, closest, [&](uint32_t s) {
+        Shape* shape = threadScene->shapes[s];
         Ray rObj = ray.Transform(shape->GetInverseTransform());
         HitInfo tmpHit;
         tmpHit.t = closest;
@@ -283,10 +1206,9 @@ bool Renderer::TraceRay(const Ray& ray, HitInfo& hit) const {
                 // Material lookup by submesh (if mesh)
                 if (auto mesh = dynamic_cast<TriangleMesh*>(shape)) {
                     if (tmpHit.submeshId < mesh->meshes.size()) {
-                        SubMesh* subMesh = mesh->meshes[tmpHit.submeshId];
-                        uint32_t matIdx = subMesh->materialIndex;
-                        if (matIdx < scene->materials.size()) {
-                            tmpHit.material = scene->materials[matIdx];
+                        uint32_t matIdx = mesh->subMeshMaterials[tmpHit.submeshId];
+                        if (matIdx < threadScene->materials.size()) {
+                            tmpHit.material = threadScene->materials[matIdx];
                         }
                     }
                 } else {
@@ -298,46 +1220,61 @@ bool Renderer::TraceRay(const Ray& ray, HitInfo& hit) const {
                 hitAny = true;
             }
         }
-    }
+        return closest;
+    });
     return hitAny;
 }
 
-glm::vec3 Renderer::TracePath(const Ray& ray, Sampler& sampler, int depth, glm::vec3 throughput, bool lastBounceDiffuse) {
-    glm::vec3 color(0.0f);
+glm::vec3 Renderer::TracePath(const Ray& ray, Sampler& sampler, int pixel) {
+    PathState path;
+    path.ray = ray;
+    path.pixel = pixel;
 
-    // Trace ray
-    HitInfo hit;
-    hit.t = FLT_MAX;
-    if (!TraceRay(ray, hit)) {
-        if (envMapEnabled) {
-            //float intensity = envMapIntensity;
-			 // TODO: Band aid before proper environment map importance sampling
-             // Only reduce for diffuse bounces
-             //if (lastBounceDiffuse && depth > 0) {
-             //    intensity *= 1e-3f;
-             //}
-            //return envMap.SampleColor(ray) * intensity;
-            return throughput * envMap.SampleColor(ray) * envMapIntensity;
+    thread_local std::vector<CacheRecord> cacheRecords;
+    cacheRecords.clear();
+
+    while (true) {
+        // Trace ray
+        HitInfo hit;
+        hit.t = FLT_MAX;
+        bool hitAny = TraceRay(path.ray, hit);
+        if (!ResolveHit(path, hitAny, hit, sampler)) break;
+        Material* mat = hit.material;
+        if (LookupRadianceCache(hit, path, mat, cacheRecords, 0)) break; // Cached radiance ends the path
+
+        // Direct lighting, then continue the path
+        LightChoice light;
+        ShadowRay shadow;
+        if (SampleDirect(hit, path, mat, sampler, light, shadow)) {
+            if (!Occluded(shadow.o, shadow.d, shadow.n, shadow.maxDist)) path.L += shadow.L;
         }
-        return glm::vec3(0.0f);
+        if (!ScatterPath(hit, path, mat, sampler, light)) break;
     }
 
-    // Russian Roulette
-	//if (depth > 8) return glm::vec3(0.0f);
-    //float pSurvive = 0.99f;
-    if (depth >= 32) {
-        float maxComp = glm::max(throughput.r, glm::max(throughput.g, throughput.b));
-        float pSurvive = glm::clamp(maxComp, 0.05f, 0.99f);
-        if (sampler.Sample1D() > pSurvive) {
-			//std::cout << "RR terminated at depth: " << depth << std::endl;
-            return glm::vec3(0.0f);
+    // Feed the outgoing radiance estimate of each cached vertex back into the cache
+    for (const CacheRecord& record : cacheRecords) UpdateRadianceCache(record, path.L);
+    return path.L;
+}
+
+// Handles escaped rays, Russian roulette and emission. Returns false once the path terminated,
+// true if the hit has to be shaded.
+bool Renderer::ResolveHit(PathState& path, bool hitAny, const HitInfo& hit, Sampler& sampler) {
+    bool lastBounceDiffuse = (path.flags & PATH_LAST_BOUNCE_DIFFUSE) != 0;
+    if (!hitAny) {
+        // With RIS, the env. map is sampled by next event estimation after non-delta bounces
+        if (envMapEnabled && !(risDirect && lastBounceDiffuse)) {
+            path.L += path.throughput * envMap.SampleColor(path.ray) * envMapIntensity;
         }
-        throughput /= pSurvive;
+        return false;
     }
 
-    glm::vec3 directLight(0.0f);
-    glm::vec3 indirectLight(0.0f);
-    int beta = 2; // Power heuristic
+    // Russian Roulette
+    if (path.depth >= 32) {
+        float maxComp = glm::max(path.throughput.r, glm::max(path.throughput.g, path.throughput.b));
+        float pSurvive = glm::clamp(maxComp, 0.05f, 0.99f);
+        if (sampler.Sample1D() > pSurvive) return false;
+        path.throughput /= pSurvive;
+    }
 
     // ===================
     // === 1. Emission ===
@@ -346,204 +1283,602 @@ glm::vec3 Renderer::TracePath(const Ray& ray, Sampler& sampler, int depth, glm::
     if (hit.areaLight != nullptr) {
         AreaLight* areaLight = dynamic_cast<AreaLight*>(hit.areaLight);
 
-        // TODO: Properly ignore area light contributions
-        // if (renderLights || depth > 4) {
-        //     return throughput * areaLight->GetRadiance(hit, *hit.shape);
-        // }
-        // Ray continueRay(hit.p + ray.d * 1e-3f, ray.d);
-        // return TracePath(continueRay, sampler, depth, throughput, lastBounceDiffuse);
-        return throughput * areaLight->GetRadiance(hit, *hit.shape);
+        // With RIS, emitters are sampled by next event estimation after non-delta bounces
+        if (!(risDirect && lastBounceDiffuse)) {
+            path.L += path.throughput * areaLight->GetRadiance(hit, *hit.shape);
+        }
+        return false;
+    }
+    return hit.material != nullptr;
+}
+
+// =========================================
+// === Radiance cache (early termination) ===
+// =========================================
+
+// Ends the path with the cached radiance at vertices past cacheMaxBounces, returning true.
+// Otherwise the vertex is recorded, if cacheable, for UpdateRadianceCache once the path ended.
+// Only view-independent (non-delta) vertices are cached, keyed by their front facing normal.
+bool Renderer::LookupRadianceCache(const HitInfo& hit, PathState& path, const Material* mat,
+                                   std::vector<CacheRecord>& records, int pathId) {
+    if (!radianceCacheEnabled || !indirectLighting || Shading::IsDelta(mat)) return false;
+    glm::vec3 cacheN = hit.front ? hit.n : -hit.n;
+    if (path.depth >= cacheMaxBounces) {
+        glm::vec3 cachedL;
+        if (radianceCache.Lookup(hit.p, cacheN, cachedL, threadCacheLayer)) {
+            path.L += path.throughput * cachedL;
+            return true;
+        }
+    }
+    records.push_back({ hit.p, cacheN, path.throughput, path.L, pathId });
+    return false;
+}
+
+// Feeds the radiance leaving a recorded vertex back into the cache, L being the path's total
+void Renderer::UpdateRadianceCache(const CacheRecord& record, const glm::vec3& L) {
+    glm::vec3 Lo(0.0f);
+    for (int c = 0; c < 3; c++) {
+        if (record.throughput[c] > 0.0f) Lo[c] = (L[c] - record.L[c]) / record.throughput[c];
     }
+    radianceCache.Update(record.p, record.n, Lo, threadCacheLayer);
+}
 
-    Material* mat = hit.material;
-	if (!mat) return glm::vec3(0.0f);
+// =====================================================
+// === 2. Sample random light, 3. Next event estimation ===
+// =====================================================
 
-    // ==============================
-    // === 2. Sample random light ===
-    // ==============================
+// Builds the shadow ray for one light sample, its unoccluded contribution already weighted
+// by throughput and MIS. RIS traces its own shadow ray and adds to the path directly.
+bool Renderer::SampleDirect(const HitInfo& hit, PathState& path, const Material* mat, Sampler& sampler,
+                            LightChoice& light, ShadowRay& shadow) {
+    int beta = 2; // Power heuristic
 
-    LightSample randomIdealLightSample;
-    randomIdealLightSample.pdf = 0.0f;
-    LightSample randomAreaLightSample;
-    randomAreaLightSample.pdf = 0.0f;
+    // Resampled importance sampling replaces steps 2 and 3
+    if (risDirect) {
+        if (!Shading::IsDelta(mat)) {
+            path.L += path.throughput * SampleDirectRIS(hit, -path.ray.d, mat, sampler, path.depth == 0 ? path.pixel : -1);
+        }
+        return false;
+    }
 
-    int nLights = static_cast<int>(scene->lights.size());
-    int lightIdx = sampler.SampleInt(0, nLights - 1);
-    float pLight = 1.0f / nLights;
-    Light* light = scene->lights[lightIdx];
+    int nLights = static_cast<int>(threadScene->lights.size());
+    if (nLights == 0) return false;
+    int lightIdx = sampler.SampleInt(0, nLights);
+    light.pLight = 1.0f / nLights;
 
     // TODO: Not huge fan of polymorphism here
-    IdealLight* idealLight = dynamic_cast<IdealLight*>(light);
-    AreaLight* areaLight = dynamic_cast<AreaLight*>(light);
-
-    if(idealLight){
-        if(!idealLight) throw std::runtime_error("Renderer::TracePath: Randomly selected ideal light that is null");
-        randomIdealLightSample = idealLight->Sample(hit, sampler);
-    } else if(areaLight){
-        if(!areaLight) throw std::runtime_error("Renderer::TracePath: Randomly selected area light that is null");
-        randomAreaLightSample = areaLight->Sample(hit, *this, sampler, *areaLight->shape);
-    }
-
-    // ================================
-    // === 3. Next event estimation ===
-    // ================================
-
-	// 1. Ideal light
-	if(randomIdealLightSample.pdf > 0.0f){
-		glm::vec3 tl = randomIdealLightSample.p - hit.p;
-		float dl = glm::length(randomIdealLightSample.p - hit.p);
-		glm::vec3 wi = tl / dl;
-		glm::vec3 wo = -ray.d;
-		glm::vec3 n = hit.front ? hit.n : -hit.n;
-		if(!Occluded(hit.p, wi, n, dl)){
-			float lightPdf = randomIdealLightSample.pdf * pLight;
-			if(lightPdf > 0.0f){
-                // TODO: Proper delta check
-				float bxdfPdf = Shading::PdfMaterial(hit, wi, wo, mat, sampler);
-                float mis = 1.0f;
-                if (bxdfPdf > 0.0f) {
-                    if (misEnabled) {
-                        float bxdfPower = glm::pow(bxdfPdf, beta);
-                        float lightPower = glm::pow(lightPdf, beta);
-                        mis = lightPower / (lightPower + bxdfPower);
-                    }
-                    // Evaluate rendering equation
-                    glm::vec3 fbrdf = Shading::ShadeMaterial(hit, wi, wo, mat);
-                    directLight += mis * throughput * randomIdealLightSample.L * fbrdf * randomIdealLightSample.weight;
-                }
-			}
-		}
-	}
+    light.idealLight = dynamic_cast<IdealLight*>(threadScene->lights[lightIdx]);
+    light.areaLight = dynamic_cast<AreaLight*>(threadScene->lights[lightIdx]);
 
-	// 2. Area light (assuming scaled point light lambertian emitter for now)
-	if(randomAreaLightSample.pdf > 0.0f){
-		glm::vec3 tl = randomAreaLightSample.p - hit.p;
-		float dl = glm::length(randomAreaLightSample.p - hit.p);
-		glm::vec3 wi = tl / dl;
-		glm::vec3 wo = -ray.d;
-		glm::vec3 n = hit.front ? hit.n : -hit.n;
-		if(!Occluded(hit.p, wi, n, dl)){
-			float lightPdf = randomAreaLightSample.pdf * pLight;
-            if (lightPdf > 0.0f) {
-                // TODO: Proper delta check
-				float bxdfPdf = Shading::PdfMaterial(hit, wi, wo, mat, sampler);
-                float mis = 1.0f;
-                if (bxdfPdf > 0.0f) {
-                    if (misEnabled) {
-                        float lightPower = glm::pow(lightPdf, beta);
-                        float bxdfPower = glm::pow(bxdfPdf, beta);
-                        mis = lightPower / (lightPower + bxdfPower);
-                    }
-                    // Evaluate rendering equation
-                    glm::vec3 fbrdf = Shading::ShadeMaterial(hit, wi, wo, mat);
-                    directLight += mis * throughput * randomAreaLightSample.L * fbrdf * randomAreaLightSample.weight;
-                }
-            }
-		}
-	}
-    
-    // ===========================================
-    // === 4. Indirect lighting (Path Tracing) ===
-    // ===========================================
-
-    if(indirectLighting) {
-
-        // Sample BxDF for new direction
-        glm::vec3 rd = -ray.d;
-        Shading::BxDFSample matSample = Shading::SampleMaterial(hit, rd, mat, sampler);
-        float bxdfPdf = matSample.pdf;
-        if (bxdfPdf <= 0.0f) return glm::vec3(0.0f); // Invalid path, terminate 
-
-        // Find light's PDF at sampled direction
-        float lightPdf = 0.0f;
-        if(idealLight){
-            lightPdf = idealLight->Pdf(hit, matSample.wo) * pLight;
-        } else if (areaLight){
-            lightPdf = areaLight->Pdf(hit, *this, matSample.wo) * pLight;
-        }
-
-        depth++;
-        float mis = 1.0f;
-        if (misEnabled) {
-            if (lightPdf == 0.0f) mis = 1.0f; // Ignore delta events
-            else {
-                float lightPower = glm::pow(lightPdf, beta);
-                float bxdfPower = glm::pow(bxdfPdf, beta);
-                mis = bxdfPower / (lightPower + bxdfPower);
+    LightSample sample;
+    sample.pdf = 0.0f;
+    if (light.idealLight) {
+        sample = light.idealLight->Sample(hit, sampler);
+    } else if (light.areaLight) {
+        // Area light (assuming scaled point light lambertian emitter for now)
+        sample = light.areaLight->Sample(hit, *this, sampler, *light.areaLight->shape);
+    }
+    if (!(sample.pdf > 0.0f)) return false;
+
+    glm::vec3 tl = sample.p - hit.p;
+    float dl = glm::length(tl);
+    glm::vec3 wi = tl / dl;
+    glm::vec3 wo = -path.ray.d;
+    float lightPdf = sample.pdf * light.pLight;
+
+    // TODO: Proper delta check
+    float bxdfPdf = Shading::PdfMaterial(hit, wi, wo, mat, sampler);
+    if (bxdfPdf <= 0.0f) return false;
+    float mis = 1.0f;
+    if (misEnabled) {
+        float lightPower = glm::pow(lightPdf, beta);
+        float bxdfPower = glm::pow(bxdfPdf, beta);
+        mis = lightPower / (lightPower + bxdfPower);
+    }
+
+    // Evaluate rendering equation
+    glm::vec3 fbrdf = Shading::ShadeMaterial(hit, wi, wo, mat);
+    shadow.o = hit.p;
+    shadow.d = wi;
+    shadow.n = hit.front ? hit.n : -hit.n;
+    shadow.maxDist = dl;
+    shadow.L = mis * path.throughput * sample.L * fbrdf * sample.weight;
+    return true;
+}
+
+// ===========================================
+// === 4. Indirect lighting (Path Tracing) ===
+// ===========================================
+
+// Samples the BxDF and advances the path to its next vertex. Returns false if the path ends here.
+bool Renderer::ScatterPath(const HitInfo& hit, PathState& path, const Material* mat, Sampler& sampler,
+                           const LightChoice& light) {
+    int beta = 2; // Power heuristic
+    if (!indirectLighting || path.depth + 1 > maxDepth) return false;
+
+    // Sample BxDF for new direction
+    glm::vec3 rd = -path.ray.d;
+    Shading::BxDFSample matSample = Shading::SampleMaterial(hit, rd, mat, sampler);
+    float bxdfPdf = matSample.pdf;
+    if (bxdfPdf <= 0.0f) return false; // Invalid path, terminate
+
+    // Find light's PDF at sampled direction
+    float lightPdf = 0.0f;
+    if (light.idealLight) {
+        lightPdf = light.idealLight->Pdf(hit, matSample.wo) * light.pLight;
+    } else if (light.areaLight) {
+        lightPdf = light.areaLight->Pdf(hit, *this, matSample.wo) * light.pLight;
+    }
+
+    float mis = 1.0f;
+    if (misEnabled) {
+        if (lightPdf == 0.0f) mis = 1.0f; // Ignore delta events
+        else {
+            float lightPower = glm::pow(lightPdf, beta);
+            float bxdfPower = glm::pow(bxdfPdf, beta);
+            mis = bxdfPower / (lightPower + bxdfPower);
+        }
+    }
+
+    // Continue the path
+    glm::vec3 f = matSample.isDelta ? glm::vec3(1.0f) : Shading::ShadeMaterial(hit, -path.ray.d, matSample.wo, mat);
+    glm::vec3 n = hit.front ? hit.n : -hit.n;
+    glm::vec3 offN = (glm::dot(matSample.wo, n) > 0.0f) ? n : -n;
+    path.throughput = mis * path.throughput * f * matSample.weight;
+    path.lastPdf = bxdfPdf;
+    path.flags = matSample.isDelta ? 0 : PATH_LAST_BOUNCE_DIFFUSE;
+    path.ray = Ray(hit.p + OCCLUDED_EPS * offN, matSample.wo);
+    path.depth++;
+    return true;
+}
+
+// Proposes one candidate, choosing uniformly among scene lights and the env. map
+bool Renderer::SampleLightCandidate(const HitInfo& hit, Sampler& sampler, LightCandidate& x, float& sourcePdf) {
+    int nLights = static_cast<int>(threadScene->lights.size());
+    int nSources = nLights + (envMapEnabled ? 1 : 0);
+    if (nSources == 0) return false;
+    int idx = sampler.SampleInt(0, nSources);
+    float pSelect = 1.0f / nSources;
+
+    // Environment map, cosine weighted around the normal
+    if (idx == nLights) {
+        glm::vec3 n = hit.front ? hit.n : -hit.n;
+        glm::vec3 d = sampler.SampleHemisphereCosine(n);
+        float pdf = glm::max(0.0f, glm::dot(n, d)) * M_1_PI;
+        if (pdf <= 0.0f) return false;
+        x.p = d;
+        x.n = -d;
+        x.L = envMap.SampleColor(Ray(hit.p, d)) * envMapIntensity;
+        x.lightIdx = -1;
+        sourcePdf = pSelect * pdf;
+        return true;
+    }
+
+    Light* light = threadScene->lights[idx];
+    if (IdealLight* idealLight = dynamic_cast<IdealLight*>(light)) {
+        LightSample ls = idealLight->Sample(hit, sampler);
+        x.p = ls.p;
+        x.n = ls.n;
+        x.L = ls.L;
+        x.lightIdx = idx;
+        sourcePdf = pSelect; // Delta light, only the discrete selection
+        return true;
+    }
+    if (AreaLight* areaLight = dynamic_cast<AreaLight*>(light)) {
+        LightSample ls = areaLight->SampleUnoccluded(hit, sampler);
+        if (ls.pdf <= 0.0f) return false;
+        x.p = ls.p;
+        x.n = ls.n;
+        x.L = ls.L;
+        x.lightIdx = idx;
+        sourcePdf = pSelect * ls.pdf;
+        return true;
+    }
+    return false;
+}
+
+// Unshadowed contribution f * L * cos of a candidate at this shading point
+glm::vec3 Renderer::EvaluateLightCandidate(const HitInfo& hit, const glm::vec3& wo, const Material* mat,
+                                           const LightCandidate& x, glm::vec3& wi, float& dist) const {
+    if (x.lightIdx < 0) {
+        wi = x.p;
+        dist = FLT_MAX;
+    }
+    else {
+        glm::vec3 tl = x.p - hit.p;
+        dist = glm::length(tl);
+        if (!(dist > 0.0f)) return glm::vec3(0.0f);
+        wi = tl / dist;
+    }
+    glm::vec3 n = hit.front ? hit.n : -hit.n;
+    float cos = glm::dot(n, wi);
+    if (cos <= 0.0f) return glm::vec3(0.0f);
+    return Shading::ShadeMaterial(hit, wi, wo, mat) * x.L * cos;
+}
+
+// Direct lighting via RIS: M candidates, one survivor picked by a weighted reservoir, one shadow ray.
+// At primary vertices (pixel >= 0) the reservoir may also merge the pixel's reservoir from previous
+// samples (temporal) and the reservoirs its neighbours had at the start of the pass (spatial).
+glm::vec3 Renderer::SampleDirectRIS(const HitInfo& hit, const glm::vec3& wo, const Material* mat, Sampler& sampler, int pixel) {
+    Reservoir r;
+    glm::vec3 wi;
+    float dist;
+    for (int i = 0; i < risCandidates; i++) {
+        LightCandidate x;
+        float sourcePdf = 0.0f;
+        if (!SampleLightCandidate(hit, sampler, x, sourcePdf)) {
+            r.M += 1.0f;
+            continue;
+        }
+        float pHat = Color::Luminance(EvaluateLightCandidate(hit, wo, mat, x, wi, dist));
+        r.Update(x, pHat / sourcePdf, sampler.Sample1D());
+    }
+
+    glm::vec3 n = hit.front ? hit.n : -hit.n;
+    bool reuse = pixel >= 0 && !risReservoirs.empty() && (risTemporalReuse || risSpatialReuse);
+    if (reuse) {
+        auto merge = [&](Reservoir q) {
+            if (q.M <= 0.0f || q.W <= 0.0f) return;
+            if (glm::dot(q.shadingN, n) < 0.9f || glm::abs(q.hitT - hit.t) > 0.1f * hit.t) return;
+            q.M = glm::min(q.M, float(RIS_HISTORY_CAP * risCandidates));
+            float pHat = Color::Luminance(EvaluateLightCandidate(hit, wo, mat, q.y, wi, dist));
+            r.Combine(q, pHat, sampler.Sample1D());
+        };
+        if (risTemporalReuse) merge(risReservoirs[pixel]);
+        if (risSpatialReuse && !risPassReservoirs.empty()) {
+            const int viewBase = pixel - pixel % (renderWidth * renderHeight);
+            int u = (pixel - viewBase) % renderWidth;
+            int v = (pixel - viewBase) / renderWidth;
+            for (int k = 0; k < RIS_SPATIAL_NEIGHBORS; k++) {
+                int nu = u + sampler.SampleInt(-RIS_SPATIAL_RADIUS, RIS_SPATIAL_RADIUS + 1);
+                int nv = v + sampler.SampleInt(-RIS_SPATIAL_RADIUS, RIS_SPATIAL_RADIUS + 1);
+                if (nu < 0 || nv < 0 || nu >= renderWidth || nv >= renderHeight) continue;
+                if (nu == u && nv == v) continue;
+                // Neighbours may be rendered by other threads, their reservoirs of this pass are not read
+                merge(risPassReservoirs[viewBase + nv * renderWidth + nu]);
             }
         }
+    }
 
-		// TODO (band aid): Check if bounce was diffuse for env. map adjustment
-		bool isDiffuse = matSample.isDelta ? false : true;
+    glm::vec3 f(0.0f);
+    if (r.wSum > 0.0f) {
+        f = EvaluateLightCandidate(hit, wo, mat, r.y, wi, dist);
+        float pHat = Color::Luminance(f);
+        r.W = pHat > 0.0f ? r.wSum / (r.M * pHat) : 0.0f;
+    }
+    if (r.W > 0.0f && Occluded(hit.p, wi, n, dist)) r.W = 0.0f;
 
-		// Evaluate rendering equation recursively
-		glm::vec3 f = matSample.isDelta ? glm::vec3(1.0f) : Shading::ShadeMaterial(hit, -ray.d, matSample.wo, mat);
-        glm::vec3 newThroughput = mis * throughput * f * matSample.weight;
-		glm::vec3 n = hit.front ? hit.n : -hit.n;
-        glm::vec3 offN = (glm::dot(matSample.wo, n) > 0.0f) ? n : -n;
-        Ray bounceRay(hit.p + OCCLUDED_EPS * offN, matSample.wo);
-        glm::vec3 Li = TracePath(bounceRay, sampler, depth, newThroughput, isDiffuse);
-        indirectLight += Li;
+    if (reuse) {
+        r.shadingN = n;
+        r.hitT = hit.t;
+        risReservoirs[pixel] = r;
     }
+    return f * r.W;
+}
 
-    // Add contributions
-    if(!indirectLighting) return directLight;
-    color += directLight + indirectLight;
-    return color;
+void Renderer::RenderTileMegakernel(const Tile& tile, TileSplitter& splitter) {
+    Sampler sampler;
+    ForEachChunk(tile, splitter, TILE_CHUNK_STEPS, [&](const Tile& chunk) {
+        ForEachPixel(chunk, [&](int u, int v) { RenderPixel(u, v, chunk, sampler); });
+    });
 }
 
-void Renderer::RenderPixel(int u, int v) {
-    std::vector<uint8_t>& buffer = GetRenderBuffer();
+void Renderer::RenderPixel(int u, int v, const Tile& tile, Sampler& sampler) {
     glm::vec3 color(0.0f);
-    Ray envRay = scene->camera->GenerateRay(u, v, renderWidth, renderHeight);
+    glm::vec3 albedo(0.0f);
+    glm::vec3 normal(0.0f);
+    int pixel = PixelIndex(u, v, tile.view);
+    if (TracePrimary(u, v, tile.view, color, albedo, normal)) {
+        sampler.Seed(PixelSeed(u, v, tile.sampleBegin));
+        for (int i = tile.sampleBegin; i < tile.sampleEnd; i++) {
+            if (Cancelled()) return;
+            glm::vec2 jitter = sampler.SampleHalton2D(2, 3, i);
+            Ray camRay = CameraRay(u + jitter.x, v + jitter.y, tile.view);
+            glm::vec3 sample = TracePath(camRay, sampler, pixel);
+            color += sample;
+        }
+        color /= float(tile.sampleEnd - tile.sampleBegin);
+    }
+    StorePixel(pixel, color, albedo, normal, tile);
+}
+
+// Traces the pixel center. On a miss color receives the background and false is returned,
+// on a hit the first hit features for the denoiser are filled in.
+bool Renderer::TracePrimary(int u, int v, int view, glm::vec3& color, glm::vec3& albedo, glm::vec3& normal) {
+    Ray envRay = CameraRay(float(u), float(v), view);
     HitInfo hit;
     hit.t = FLT_MAX;
-    bool hitAny = TraceRay(envRay, hit);
-    if (!hitAny) {
+    if (!TraceRay(envRay, hit)) {
         if (envMapEnabled) color = envMap.SampleColor(envRay) * envMapIntensity;
         else color = glm::vec3(0.0f);
+        albedo = glm::clamp(color, 0.0f, 1.0f);
+        return false;
     }
-    else {
-        Sampler sampler(u * renderWidth + v);
-        int depth = 0;
-        for (int i = 0; i < spp; i++) {
-            glm::vec2 jitter = sampler.SampleHalton2D(2, 3, i);
-            Ray camRay = scene->camera->GenerateRay(u + jitter.x, v + jitter.y, renderWidth, renderHeight);
-            glm::vec3 sample = TracePath(camRay, sampler, depth);
-            color += sample;
+
+    // Emitters are treated as white
+    albedo = hit.areaLight ? glm::vec3(1.0f) : Shading::Albedo(hit, hit.material);
+    normal = hit.front ? hit.n : -hit.n;
+    return true;
+}
+
+// Different seed per sample range, the first range keeps the single pass seed
+uint32_t Renderer::PixelSeed(int u, int v, int sampleBegin) const {
+    return static_cast<uint32_t>(u * renderWidth + v) + static_cast<uint32_t>(sampleBegin) * static_cast<uint32_t>(renderWidth * renderHeight);
+}
+
+// Keeps the running mean over progressive passes, color is the mean of the tile's samples
+void Renderer::StorePixel(int pixel, const glm::vec3& color, const glm::vec3& albedo, const glm::vec3& normal, const Tile& tile) {
+    if (tile.sampleBegin == 0) film[pixel] = color;
+    else film[pixel] += (color - film[pixel]) * (float(tile.sampleEnd - tile.sampleBegin) / float(tile.sampleEnd));
+    albedoAOV[pixel] = albedo;
+    normalAOV[pixel] = normal;
+    WritePixel(pixel, film[pixel]);
+}
+
+// Groups hits by material type first, then by material, so shading runs over coherent groups
+static inline uint64_t ShadingSortKey(const Material* mat) {
+    return (uint64_t(mat->GetType()) << 56) | (uint64_t(reinterpret_cast<uintptr_t>(mat)) & 0x00FFFFFFFFFFFFFFull);
+}
+
+// Wavefront integrator: paths of a tile advance one bounce at a time through separate stages
+// (extend, resolve, sort by material, shade, trace shadow rays) instead of one path at a time.
+// The tile is rendered in chunks of pixels holding about WAVEFRONT_BATCH_SIZE paths, so idle
+// threads can take over the rest of it, and samples in chunks when a pixel alone has more.
+void Renderer::RenderTileWavefront(const Tile& tile, TileSplitter& splitter) {
+    // Queues are reused between chunks and tiles
+    thread_local std::vector<int> pixels; // Image local, the view is the tile's
+    thread_local std::vector<glm::vec3> color, albedo, normal;
+    thread_local std::vector<Sampler> samplers;
+    thread_local std::vector<int> sampled; // Chunk local indices of pixels whose center hit geometry
+    thread_local std::vector<PathState> paths, nextPaths;
+    thread_local std::vector<int> owner, nextOwner; // Chunk local pixel of each path
+    thread_local std::vector<int> pathId, nextPathId; // Index of each path in the sample chunk
+    thread_local std::vector<glm::vec3> pathL; // Radiance of each path of the sample chunk once it ended
+    thread_local std::vector<CacheRecord> cacheRecords;
+    thread_local std::vector<HitInfo> hits;
+    thread_local std::vector<uint8_t> hitAny, alive;
+    thread_local std::vector<LightChoice> lights;
+    thread_local std::vector<std::pair<uint64_t, int>> shadeQueue;
+    thread_local std::vector<ShadowRay> shadowRays;
+
+    const int pixelBase = PixelIndex(0, 0, tile.view);
+    const int nSamples = tile.sampleEnd - tile.sampleBegin;
+    const int chunkSteps = glm::max(TILE_CHUNK_STEPS, WAVEFRONT_BATCH_SIZE / glm::max(1, nSamples));
+    ForEachChunk(tile, splitter, chunkSteps, [&](const Tile& pixelChunk) {
+        if (Cancelled()) return;
+        pixels.clear();
+        ForEachPixel(pixelChunk, [&](int u, int v) { pixels.push_back(v * renderWidth + u); });
+        const int nPixels = static_cast<int>(pixels.size());
+        color.assign(nPixels, glm::vec3(0.0f));
+        albedo.assign(nPixels, glm::vec3(0.0f));
+        normal.assign(nPixels, glm::vec3(0.0f));
+        samplers.clear();
+        sampled.clear();
+        for (int i = 0; i < nPixels; i++) {
+            int u = pixels[i] % renderWidth;
+            int v = pixels[i] / renderWidth;
+            samplers.emplace_back(PixelSeed(u, v, tile.sampleBegin));
+            if (TracePrimary(u, v, tile.view, color[i], albedo[i], normal[i])) sampled.push_back(i);
         }
-        color /= float(spp);
-    }
+
+        int chunk = glm::max(1, WAVEFRONT_BATCH_SIZE / glm::max(1, static_cast<int>(sampled.size())));
+        for (int s0 = tile.sampleBegin; s0 < tile.sampleEnd && !sampled.empty(); s0 += chunk) {
+            int s1 = glm::min(tile.sampleEnd, s0 + chunk);
+            // Camera rays
+            paths.clear();
+            owner.clear();
+            pathId.clear();
+            cacheRecords.clear();
+            for (int i : sampled) {
+                int u = pixels[i] % renderWidth;
+                int v = pixels[i] / renderWidth;
+                for (int s = s0; s < s1; s++) {
+                    glm::vec2 jitter = samplers[i].SampleHalton2D(2, 3, s);
+                    PathState path;
+                    path.ray = CameraRay(u + jitter.x, v + jitter.y, tile.view);
+                    path.pixel = PixelIndex(u, v, tile.view);
+                    pathId.push_back(static_cast<int>(paths.size()));
+                    paths.push_back(path);
+                    owner.push_back(i);
+                }
+            }
+            pathL.assign(paths.size(), glm::vec3(0.0f));
+
+            while (!paths.empty()) {
+                if (Cancelled()) return;
+                const size_t n = paths.size();
+
+                // 1. Extend
+                hits.assign(n, HitInfo());
+                hitAny.resize(n);
+                for (size_t k = 0; k < n; k++) {
+                    hitAny[k] = TraceRay(paths[k].ray, hits[k]);
+                }
+
+                // 2. Resolve misses, emission and roulette, terminated paths splat into their pixel
+                shadeQueue.clear();
+                for (size_t k = 0; k < n; k++) {
+                    if (ResolveHit(paths[k], hitAny[k] != 0, hits[k], samplers[owner[k]])) {
+                        shadeQueue.emplace_back(ShadingSortKey(hits[k].material), static_cast<int>(k));
+                    }
+                    else {
+                        color[owner[k]] += paths[k].L;
+                        pathL[pathId[k]] = paths[k].L;
+                    }
+                }
+
+                // 3. Sort by material
+                std::sort(shadeQueue.begin(), shadeQueue.end());
+
+                // 4. Shade, queueing shadow rays. Paths ending on cached radiance are not shaded.
+                shadowRays.clear();
+                lights.resize(n);
+                alive.assign(n, 0);
+                for (const auto& item : shadeQueue) {
+                    int k = item.second;
+                    Sampler& sampler = samplers[owner[k]];
+                    const Material* mat = hits[k].material;
+                    if (LookupRadianceCache(hits[k], paths[k], mat, cacheRecords, pathId[k])) continue;
+                    ShadowRay shadow;
+                    lights[k] = LightChoice();
+                    if (SampleDirect(hits[k], paths[k], mat, sampler, lights[k], shadow)) {
+                        shadow.path = k;
+                        shadowRays.push_back(shadow);
+                    }
+                    alive[k] = ScatterPath(hits[k], paths[k], mat, sampler, lights[k]);
+                }
+
+                // 5. Trace shadow rays
+                for (const ShadowRay& shadow : shadowRays) {
+                    if (!Occluded(shadow.o, shadow.d, shadow.n, shadow.maxDist)) paths[shadow.path].L += shadow.L;
+                }
+
+                // 6. Compact, survivors form the next wave
+                nextPaths.clear();
+                nextOwner.clear();
+                nextPathId.clear();
+                for (const auto& item : shadeQueue) {
+                    int k = item.second;
+                    if (alive[k]) {
+                        nextPaths.push_back(paths[k]);
+                        nextOwner.push_back(owner[k]);
+                        nextPathId.push_back(pathId[k]);
+                    }
+                    else {
+                        color[owner[k]] += paths[k].L;
+                        pathL[pathId[k]] = paths[k].L;
+                    }
+                }
+                std::swap(paths, nextPaths);
+                std::swap(owner, nextOwner);
+                std::swap(pathId, nextPathId);
+            }
+
+            // Every path of the chunk ended, feed their cached vertices back
+            for (const CacheRecord& record : cacheRecords) UpdateRadianceCache(record, pathL[record.path]);
+        }
+
+        for (int i : sampled) color[i] /= float(nSamples);
+        for (int i = 0; i < nPixels; i++) {
+            StorePixel(pixelBase + pixels[i], color[i], albedo[i], normal[i], tile);
+        }
+    });
+}
+
+// Tonemaps a linear radiance value into the 8 bit display buffer. Stereo views are
+// composited there: as an anaglyph, or side by side (also for separate file output).
+void Renderer::WritePixel(int pixel, glm::vec3 color) {
+    std::vector<uint8_t>& buffer = GetRenderBuffer();
     if (tonemap) Color::UnchartedTonemapFilmic(color, exposureBias);
     if (gammaCorrect) Color::GammaCorrect(color);
-    int index = (v * renderWidth + u) * 3;
+    const int viewPixels = renderWidth * renderHeight;
+    const int view = pixel / viewPixels;
+    const int local = pixel % viewPixels;
     uint8_t r = static_cast<uint8_t>(glm::clamp(color.r, 0.0f, 1.0f) * 255);
     uint8_t g = static_cast<uint8_t>(glm::clamp(color.g, 0.0f, 1.0f) * 255);
     uint8_t b = static_cast<uint8_t>(glm::clamp(color.b, 0.0f, 1.0f) * 255);
 
-    if (renderStereo) {
-        if (renderingLeftEye) {
+    if (renderStereo && stereoOutput == StereoOutput::Anaglyph) {
+        int index = local * 3;
+        if (view == 0) {
             buffer[index + 1] = g;
             buffer[index + 2] = b;
         }
         else {
             buffer[index + 0] = r;
         }
+        return;
     }
-    else {
-        buffer[index + 0] = r;
-        buffer[index + 1] = g;
-        buffer[index + 2] = b;
+    int u = local % renderWidth;
+    int v = local / renderWidth;
+    if (renderStereo) u += view * renderWidth; // Side by side
+    else v += view * renderHeight; // Animation batch, stacked frames
+    int index = (v * displayWidth + u) * 3;
+    buffer[index + 0] = r;
+    buffer[index + 1] = g;
+    buffer[index + 2] = b;
+}
+
+// Runs once the frame is complete, before SaveImage. The film keeps the raw estimate,
+// only the display buffer receives the denoised result. The filter runs as jobs on the
+// render pool, false if it was cancelled between two of them.
+bool Renderer::ResolveFilm() {
+    if (!denoise || film.empty()) return true;
+    auto start = std::chrono::steady_clock::now();
+    auto parallelFor = [this](int count, const std::function<void(int)>& body) {
+        return !Cancelled() && threadPool->ParallelFor(count, body);
+    };
+    // Views are filtered separately, so the filter does not reach across images
+    const size_t viewPixels = size_t(renderWidth) * renderHeight;
+    for (int view = 0; view < views; view++) {
+        auto first = [&](const std::vector<glm::vec3>& buf) { return buf.begin() + view * viewPixels; };
+        std::vector<glm::vec3> denoised(first(film), first(film) + viewPixels);
+        std::vector<glm::vec3> albedo(first(albedoAOV), first(albedoAOV) + viewPixels);
+        std::vector<glm::vec3> normal(first(normalAOV), first(normalAOV) + viewPixels);
+        if (!Denoiser::ATrous(denoised, albedo, normal, renderWidth, renderHeight, denoiseIterations, parallelFor)) return false;
+        for (size_t i = 0; i < viewPixels; i++) {
+            WritePixel(static_cast<int>(view * viewPixels + i), denoised[i]);
+        }
     }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Denoised in " << ms << " ms" << std::endl;
+    return true;
 }
 
 bool Renderer::LoadScene(const std::string& filename) {
     strncpy(scenePath, filename.c_str(), sizeof(scenePath) - 1);
     scenePath[sizeof(scenePath) - 1] = '\0';
+    LoadedScene loaded;
+    if (!LoadSceneFile(scenePath, loaded)) return false;
+    batchCameras.clear();
+    batchScenes.clear();
+    this->pbrtScene = loaded.pbrtScene;
+    this->scene = std::move(loaded.scene);
+    sceneId++;
+    AssetCache::Get().Trim(); // Assets only the old scene used can go now
+    return true;
+}
+
+bool Renderer::LoadSceneFile(const std::string& filename, LoadedScene& out) {
+	PbrtLoader pbrtLoader;
+	if(!pbrtLoader.LoadScene(filename)) {
+		std::cerr << "Error loading PBRT scene from file: " << filename << std::endl;
+		return false;
+	}
+	return ConvertPbrtScene(pbrtLoader.GetScene(), out);
+}
+
+// Camera of a scene file, without importing its shapes
+bool Renderer::LoadCamera(const std::string& filename, std::unique_ptr<Camera>& out) {
 	PbrtLoader pbrtLoader;
-	if(!pbrtLoader.LoadScene(scenePath)) {
-		std::cerr << "Error loading PBRT scene from file: " << scenePath << std::endl;
+	if(!pbrtLoader.LoadScene(filename)) {
+		std::cerr << "Error loading PBRT scene from file: " << filename << std::endl;
 		return false;
 	}
-	return SetPbrtScene(pbrtLoader.GetScene());
+	std::unique_ptr<minipbrt::Scene> pbrt(pbrtLoader.GetScene());
+	out.reset(PbrtConverter::ConvertCamera(pbrt->camera));
+	if (!out) std::cerr << "Error: Unsupported camera in " << filename << std::endl;
+	return out != nullptr;
+}
+
+// Hash of everything after WorldBegin, equal for frames that differ only by camera and options.
+// 0 when the file cannot be read.
+size_t Renderer::SceneBodyHash(const std::string& filename) {
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) return 0;
+	std::stringstream ss;
+	ss << file.rdbuf();
+	const std::string text = ss.str();
+	size_t world = text.find("WorldBegin");
+	return std::hash<std::string>{}(world == std::string::npos ? text : text.substr(world)) | 1;
+}
+
+// Frames per animation batch. Batching pays off when a frame has too few tiles to keep
+// every thread busy, so the automatic size aims for ANIM_BATCH_TILES tiles per thread.
+int Renderer::AnimationBatchSize(const RenderSettings& rs) const {
+	if (rs.animBatch > 0) return std::min(rs.animBatch, ANIM_BATCH_MAX);
+	const int threads = rs.threads > 0 ? rs.threads : static_cast<int>(NTHREADS);
+	const int size = std::max(rs.tileSize, 1);
+	const int tiles = ((rs.width + size - 1) / size) * ((rs.height + size - 1) / size);
+	return glm::clamp(threads * ANIM_BATCH_TILES / std::max(tiles, 1), 1, ANIM_BATCH_MAX);
 }
\ No newline at end of file
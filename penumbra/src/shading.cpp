@@ -356,11 +356,7 @@ float Shading::PdfDisney(const HitInfo& hit,
                          const DisneyMaterial* disney,
                          Sampler& sampler) {
 
-    float EPS = 1e-4f;
-    bool isDelta = disney->roughness < EPS &&
-            (disney->metallic > 1.0f - EPS ||
-		     disney->eta > 1.0f);
-    if (isDelta) return 0.0f;
+    if (IsDelta(disney)) return 0.0f;
 
 	glm::vec3 n = hit.front ? hit.n : -hit.n;
 	float nDotWi = glm::dot(n, wi);
@@ -391,4 +387,28 @@ float Shading::PdfDisney(const HitInfo& hit,
 	}
 
     return pdf;
-}
\ No newline at end of file
+}
+
+// Perfect glass and mirror lobes, which have no evaluable PDF
+bool Shading::IsDelta(const Material* material) {
+    if (material->GetType() != minipbrt::MaterialType::Disney) return false;
+    auto disney = static_cast<const DisneyMaterial*>(material);
+    float EPS = 1e-4f;
+    return disney->roughness < EPS &&
+           (disney->metallic > 1.0f - EPS ||
+            disney->eta > 1.0f);
+}
+
+// Denoiser guide, clear glass reports white so the filter sees through it
+glm::vec3 Shading::Albedo(const HitInfo& hit, const Material* material) {
+    if (!material) return glm::vec3(0.0f);
+    if (material->GetType() == minipbrt::MaterialType::Matte) {
+        return static_cast<const MatteMaterial*>(material)->albedo;
+    }
+    if (material->GetType() == minipbrt::MaterialType::Disney) {
+        auto disney = static_cast<const DisneyMaterial*>(material);
+        if (IsDelta(disney) && disney->metallic < 1.0f - 1e-4f) return glm::vec3(1.0f);
+        return glm::clamp(disney->GetAlbedo(hit.uv), 0.0f, 1.0f);
+    }
+    return glm::vec3(0.0f);
+}
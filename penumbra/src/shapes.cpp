@@ -1,13 +1,25 @@
 ﻿#include "shapes.h"
+#include "numa.h"
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
 #include <filesystem>
+#include <iomanip>
 
 #include "materials.h"
 #include "scene.h"
+#include "assetcache.h"
+#include "plyloader.h"
+#include "utils.h"
 
 #define SPHERE_EPS 1e-8f
 #define TRI_EPS 1e-6f
 
+// NOTE: Assuming flipped winding order for PBRT
+#define MESH_IMPORT_FLAGS (aiProcess_Triangulate | aiProcess_FlipWindingOrder | aiProcess_CalcTangentSpace)
+
 // === Ray intersections ===
 bool Sphere::IntersectRay(const Ray& r, HitInfo& hit) {
     float a = glm::dot(r.d, r.d);
@@ -58,11 +70,19 @@ bool TriangleMesh::IntersectRay(const Ray& r, HitInfo& hit) {
     bool hitAny = false;
     float closest = FLT_MAX;
 
+    const int node = Numa::CurrentNode();
     unsigned int nMeshes = meshes.size();
     for(int i = 0; i < nMeshes; i++){
         SubMesh* mesh = meshes[i];
         if (!mesh->bvhReady) continue;
 
+        // Read the copy on this thread's NUMA node when there is one
+        const SubMeshReplica* replica = node > 0 && node <= int(mesh->replicas.size()) ? mesh->replicas[node - 1].get() : nullptr;
+        const tinybvh::BVH_SoA& bvh = replica ? replica->bvh : mesh->bvh;
+        const MeshBuffers& geometry = replica ? static_cast<const MeshBuffers&>(*replica) : *mesh;
+        const glm::vec4* vertices = geometry.vertices;
+        const glm::uvec3* triangles = geometry.triangles;
+
         float s = glm::length(glm::vec3(transform * glm::vec4(r.d, 0.0f)));
         if (!(s > 0.0f)) continue;
 
@@ -70,16 +90,17 @@ bool TriangleMesh::IntersectRay(const Ray& r, HitInfo& hit) {
         if (!(tMaxObj > 0.0f)) tMaxObj = FLT_MAX;
 
         tinybvh::Ray ray(r.o, r.d, tMaxObj);
-        mesh->bvh.Intersect(ray);
+        bvh.Intersect(ray);
 
         if (ray.hit.t >= tMaxObj) continue;
 
         uint32_t idx = ray.hit.prim;
         if (idx >= mesh->nTris) continue;
 
-        const glm::vec3 v0 = glm::vec3(mesh->bvhTriSoup[3ull * idx + 0]);
-        const glm::vec3 v1 = glm::vec3(mesh->bvhTriSoup[3ull * idx + 1]);
-        const glm::vec3 v2 = glm::vec3(mesh->bvhTriSoup[3ull * idx + 2]);
+        const glm::uvec3& triIdx = triangles[idx];
+        const glm::vec3 v0 = glm::vec3(vertices[triIdx.x]);
+        const glm::vec3 v1 = glm::vec3(vertices[triIdx.y]);
+        const glm::vec3 v2 = glm::vec3(vertices[triIdx.z]);
 
         glm::vec3 e1 = v1 - v0;
         glm::vec3 e2 = v2 - v0;
@@ -108,39 +129,20 @@ bool TriangleMesh::IntersectRay(const Ray& r, HitInfo& hit) {
             glm::vec3 pObj = r.At(tObj);
             glm::vec3 pW = glm::vec3(transform * glm::vec4(pObj, 1.0f));
 
-            // Compute world-space normal
-            const glm::uvec4& triIdx = (*mesh->triangles)[idx];
-            glm::vec3 n0 = (*mesh->normals)[triIdx.x];
-            glm::vec3 n1 = (*mesh->normals)[triIdx.y];
-            glm::vec3 n2 = (*mesh->normals)[triIdx.z];
-            glm::vec3 nObj = glm::normalize((1.0f - u - v) * n0 + u * n1 + v * n2);
+            // Interpolate the shading attributes, then take them to world space
+            glm::vec3 nObj, tObj, bObj;
+            geometry.Interpolate(triIdx, u, v, nObj, tObj, bObj, hit.uv);
             glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
             glm::vec3 nW = glm::normalize(normalMatrix * nObj);
 
-            // Interpolate tangent and bitangent (if they exist)
+            // Tangent and bitangent (if they exist)
             glm::vec3 tW = glm::vec3(0.0f);
             glm::vec3 bW = glm::vec3(0.0f);
-            if (mesh->tangents && mesh->bitangents) {
-                glm::vec3 t0 = (*mesh->tangents)[triIdx.x];
-                glm::vec3 t1 = (*mesh->tangents)[triIdx.y];
-                glm::vec3 t2 = (*mesh->tangents)[triIdx.z];
-                glm::vec3 tObj = glm::normalize((1.0f - u - v) * t0 + u * t1 + v * t2);
+            if (geometry.GetAttributes() & MeshBuffers::TangentFrames) {
                 tW = glm::normalize(normalMatrix * tObj);
-
-                glm::vec3 b0 = (*mesh->bitangents)[triIdx.x];
-                glm::vec3 b1 = (*mesh->bitangents)[triIdx.y];
-                glm::vec3 b2 = (*mesh->bitangents)[triIdx.z];
-                glm::vec3 bObj = glm::normalize((1.0f - u - v) * b0 + u * b1 + v * b2);
                 bW = glm::normalize(normalMatrix * bObj);
             }
 
-            // Interpolate UV coordinates
-            if(mesh->uvs){
-                hit.uv = (1.0f - u - v) * (*mesh->uvs)[triIdx.x] + 
-                                      u * (*mesh->uvs)[triIdx.y] + 
-                                      v * (*mesh->uvs)[triIdx.z];
-            } else hit.uv = glm::vec2(0.0f);
-
             hit.t = tWorld;
             hit.p = pW;
             hit.n = nW;
@@ -153,7 +155,7 @@ bool TriangleMesh::IntersectRay(const Ray& r, HitInfo& hit) {
             hit.material = material;
             hit.areaLight = areaLight;
             hit.submeshId = i;
-			hit.materialId = mesh->materialIndex;
+			hit.materialId = subMeshMaterials[i];
             hitAny = true;
         }
     }
@@ -163,14 +165,18 @@ bool TriangleMesh::IntersectRay(const Ray& r, HitInfo& hit) {
 
 
 // === PBRT Conversion Constructors ===
-Sphere::Sphere(minipbrt::Sphere* pbrtSphere) {
-    this->transform = PbrtConverter::TransformToMat4(pbrtSphere->shapeToWorld);
+void Shape::SetTransform(const glm::mat4& shapeToWorld) {
+    this->transform = shapeToWorld;
     this->inverseTransform = glm::inverse(this->transform);
     this->position = glm::vec3(this->transform[3]);
     this->scale = glm::vec3(
         glm::length(glm::vec3(this->transform[0])),
         glm::length(glm::vec3(this->transform[1])),
         glm::length(glm::vec3(this->transform[2])));
+}
+
+Sphere::Sphere(minipbrt::Sphere* pbrtSphere) {
+    SetTransform(PbrtConverter::TransformToMat4(pbrtSphere->shapeToWorld));
     this->materialId = static_cast<int>(pbrtSphere->material);
     this->areaLightId = static_cast<int>(pbrtSphere->areaLight);
     this->radius = pbrtSphere->radius;
@@ -190,31 +196,60 @@ TriangleMesh::TriangleMesh(minipbrt::PLYMesh* plyMesh, Scene& scene, uint32_t me
         // Minipbrt works from the scenes dir, so we need to clean the path
         meshPath = meshPath.substr(pos);
     }
-    if (!LoadMeshWithAssimp(meshPath, scene, meshIdx)) {
+    if (!LoadMesh(meshPath, scene, meshIdx)) {
         std::cerr << "Failed to load mesh: " << meshPath << std::endl;
         return;
     }
-    this->transform = PbrtConverter::TransformToMat4(plyMesh->shapeToWorld);
-    this->inverseTransform = glm::inverse(this->transform);
-    this->position = glm::vec3(this->transform[3]);
-    this->scale = glm::vec3(
-        glm::length(glm::vec3(this->transform[0])),
-        glm::length(glm::vec3(this->transform[1])),
-        glm::length(glm::vec3(this->transform[2])));
+    SetTransform(PbrtConverter::TransformToMat4(plyMesh->shapeToWorld));
     this->materialId = static_cast<int>(plyMesh->material);
     this->areaLightId = static_cast<int>(plyMesh->areaLight);
 
     // TODO: Calculate surface area if mesh is area light
 }
 
-TriangleMesh::~TriangleMesh() {
-    for (auto mesh : meshes) {
-        delete mesh;
+// === Mesh instancing ===
+// Takes the mesh file's submeshes from the asset cache, importing them on a miss, and binds
+// them to this scene's materials
+bool TriangleMesh::LoadMesh(const std::string& filename, Scene& scene, uint32_t shapeIdx) {
+    std::string key = AssetCache::FileKey("mesh", filename, MESH_IMPORT_FLAGS);
+    asset = AssetCache::Get().Acquire<MeshAsset>(key, [&](size_t& bytes) {
+        return ImportMesh(filename, AssetCache::Get().TakeSuperseded<MeshAsset>(key), bytes);
+    });
+    if (!asset) return false;
+    path = filename;
+
+    for (size_t i = 0; i < asset->subMeshes.size(); i++) {
+        // The asset keeps the textures of its import. Acquiring them again by path picks up
+        // texture files edited since, without importing the mesh again.
+        const MeshAsset::Textures& imported = asset->textures[i];
+        MeshAsset::Textures bound;
+        if (imported.albedo) bound.albedo = LoadTexture(imported.albedo->GetPath());
+        if (imported.roughness) bound.roughness = LoadTexture(imported.roughness->GetPath(), 1);
+        if (imported.metallic) bound.metallic = LoadTexture(imported.metallic->GetPath(), 1);
+        if (imported.normal) bound.normal = LoadTexture(imported.normal->GetPath());
+        textures.push_back(bound);
+
+        // TODO (CRITICAL): Band aid; For now, assume first submesh uses first PBRT material, etc.
+        uint32_t matIdx = shapeIdx + static_cast<uint32_t>(i);
+        if (matIdx < (int)scene.materials.size()) {
+            auto disneyMtl = static_cast<DisneyMaterial*>(scene.materials[matIdx]);
+            disneyMtl->albedoTexture = bound.albedo.get();
+            disneyMtl->roughnessTexture = bound.roughness.get();
+            disneyMtl->metallicTexture = bound.metallic.get();
+            disneyMtl->normalTexture = bound.normal.get();
+        } else {
+            std::cout << "WARNING: Material index " << matIdx << " out of bounds (scene has " 
+                    << scene.materials.size() << " materials)" << std::endl;
+            matIdx = 0;
+        }
+        meshes.push_back(asset->subMeshes[i].get());
+        subMeshMaterials.push_back(matIdx);
     }
+    return true;
 }
 
 // === Texture loading with Assimp ===
-Texture* TriangleMesh::LoadTextureWithAssimp(aiMaterial* aiMat, aiTextureType type, const char* meshName) {
+std::shared_ptr<Texture> TriangleMesh::LoadTextureWithAssimp(aiMaterial* aiMat, aiTextureType type, const char* meshName) {
     aiString texPath;
     aiReturn texReturn;
     texReturn = aiMat->GetTexture(type, 0, &texPath);
@@ -225,75 +260,247 @@ Texture* TriangleMesh::LoadTextureWithAssimp(aiMaterial* aiMat, aiTextureType ty
 
 	std::cout << "Info: Found texture: " << TextureTypeToString(type) << " for mesh " << meshName << std::endl;
 
+    // Roughness and metallic maps are sampled for one value, they keep one channel
+    int channels = type == aiTextureType_DIFFUSE_ROUGHNESS || type == aiTextureType_METALNESS ? 1 : 3;
+    return LoadTexture(ResolveTexturePath(texPath.C_Str()), channels);
+}
+
+// Textures referenced by mesh files live in the textures dir, whatever path the file names
+std::string TriangleMesh::ResolveTexturePath(const std::string& path) {
     // Extract just the filename
-    std::string fullTexPath = std::string(texPath.C_Str());
-    std::string filename = fullTexPath.substr(fullTexPath.find_last_of("/\\") + 1);
+    std::string filename = path.substr(path.find_last_of("/\\") + 1);
 
     // Construct path relative to executable
-    std::string resolvedPath = "./resources/textures/" + filename;
+    return "./resources/textures/" + filename;
+}
 
-    Texture* texture = new Texture();
-    if (texture->Load(resolvedPath.c_str())) {
+std::shared_ptr<Texture> TriangleMesh::LoadTexture(const std::string& path, int channels) {
+    std::string key = AssetCache::FileKey("texture", path, static_cast<uint32_t>(channels));
+    return AssetCache::Get().Acquire<Texture>(key, [&](size_t& bytes) {
+        auto texture = std::make_shared<Texture>();
+        if (!texture->Load(path, channels)) {
+            std::cerr << "Failed to load texture: " << path << std::endl;
+            return std::shared_ptr<Texture>();
+        }
+        bytes = texture->GetMemoryBytes();
         return texture;
+    });
+}
+
+std::vector<std::string> TriangleMesh::GetTexturePaths() const {
+    std::vector<std::string> paths;
+    for (const MeshAsset::Textures& t : textures) {
+        for (const Texture* texture : { t.albedo.get(), t.roughness.get(), t.metallic.get(), t.normal.get() }) {
+            if (texture) paths.push_back(texture->GetPath());
+        }
     }
-    else {
-        std::cerr << "Failed to load texture: " << resolvedPath << std::endl;
+    return paths;
+}
+
+// === Mesh import ===
+// Binary PLY files take the native reader, other formats, and PLY files it turns down, Assimp.
+// Both produce what MESH_IMPORT_FLAGS asks for.
+std::shared_ptr<MeshAsset> TriangleMesh::ImportMesh(const std::string& filename, const std::shared_ptr<MeshAsset>& previous, size_t& bytes) {
+    auto start = std::chrono::steady_clock::now();
+    std::error_code ec;
+    const uintmax_t fileBytes = std::filesystem::file_size(filename, ec);
+    std::string ext = std::filesystem::path(filename).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+
+    const char* importer = "PLY";
+    std::shared_ptr<MeshAsset> asset;
+    if (ext == ".ply") asset = LoadMeshWithPly(filename, previous, bytes);
+    if (!asset) {
+        importer = "Assimp";
+        asset = LoadMeshWithAssimp(filename, previous, bytes);
+    }
+    if (asset && !ec) {
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double mb = static_cast<double>(fileBytes) / (1024.0 * 1024.0);
+        std::cout << "Imported " << filename << " with " << importer << ": " << std::fixed << std::setprecision(1)
+                  << mb << " MB in " << s * 1e3 << " ms (" << (s > 0.0 ? mb / s : 0.0) << " MB/s, BLAS included)"
+                  << std::defaultfloat << std::endl;
+    }
+    return asset;
+}
+
+// Per vertex tangent frames from the UV parametrization, what aiProcess_CalcTangentSpace
+// computes: face tangents accumulated on their vertices, then made orthogonal to the normal
+static void CalcTangentSpace(SubMesh& mesh) {
+    const glm::vec4* v = mesh.vertices;
+    const glm::vec2* uv = mesh.uvs;
+    std::vector<glm::vec3> tangents(mesh.nVerts, glm::vec3(0.0f));
+    std::vector<glm::vec3> bitangents(mesh.nVerts, glm::vec3(0.0f));
+    for (uint32_t f = 0; f < mesh.nTris; f++) {
+        const glm::uvec3& t = mesh.triangles[f];
+        glm::vec3 dp1 = glm::vec3(v[t.y] - v[t.x]), dp2 = glm::vec3(v[t.z] - v[t.x]);
+        glm::vec2 duv1 = uv[t.y] - uv[t.x], duv2 = uv[t.z] - uv[t.x];
+        float det = duv1.x * duv2.y - duv2.x * duv1.y;
+        if (std::abs(det) < 1e-12f) continue; // No parametrization, left to the fallback below
+        float r = 1.0f / det;
+        glm::vec3 tangent = (dp1 * duv2.y - dp2 * duv1.y) * r;
+        glm::vec3 bitangent = (dp2 * duv1.x - dp1 * duv2.x) * r;
+        for (uint32_t i : { t.x, t.y, t.z }) {
+            tangents[i] += tangent;
+            bitangents[i] += bitangent;
+        }
+    }
+    for (uint32_t i = 0; i < mesh.nVerts; i++) {
+        glm::vec3 n = mesh.normals[i];
+        glm::vec3 t = tangents[i] - n * glm::dot(n, tangents[i]);
+        glm::vec3 b = bitangents[i] - n * glm::dot(n, bitangents[i]);
+        if (glm::dot(t, t) < 1e-20f || glm::dot(b, b) < 1e-20f) {
+            Utils::Orthonormals(n, t, b);
+        } else {
+            t = glm::normalize(t);
+            b = glm::normalize(b);
+        }
+        mesh.tangents[i] = t;
+        mesh.bitangents[i] = b;
+    }
+}
+
+// === Mesh loading with the native PLY reader ===
+std::shared_ptr<MeshAsset> TriangleMesh::LoadMeshWithPly(const std::string& filename, const std::shared_ptr<MeshAsset>& previous, size_t& bytes) {
+    PlyLoader::Mesh ply;
+    std::string error;
+    if (!PlyLoader::Read(filename, ply, error)) {
+        std::cout << "Info: Native PLY reader skipped " << filename << " (" << error << "), using Assimp" << std::endl;
         return nullptr;
     }
+
+    auto asset = std::make_shared<MeshAsset>();
+    auto mesh = std::make_unique<SubMesh>();
+    uint32_t attributes = 0;
+    if (!ply.normals.empty()) attributes |= MeshBuffers::Normals;
+    if (!ply.uvs.empty()) attributes |= MeshBuffers::Uvs;
+    if (!ply.normals.empty() && !ply.uvs.empty()) attributes |= MeshBuffers::TangentFrames;
+    mesh->Allocate(static_cast<uint32_t>(ply.vertices.size()), static_cast<uint32_t>(ply.triangles.size()), attributes);
+    std::copy(ply.vertices.begin(), ply.vertices.end(), mesh->vertices);
+    for (const glm::vec4& v : ply.vertices) asset->bounds.Grow(glm::vec3(v));
+
+    // aiProcess_FlipWindingOrder
+    for (uint32_t i = 0; i < mesh->nTris; i++) {
+        const glm::uvec3& t = ply.triangles[i];
+        mesh->triangles[i] = glm::uvec3(t.z, t.y, t.x);
+    }
+
+    if (mesh->normals) std::copy(ply.normals.begin(), ply.normals.end(), mesh->normals);
+    else std::cerr << "  Warning: No normals found for mesh ..." << std::endl;
+    if (mesh->uvs) std::copy(ply.uvs.begin(), ply.uvs.end(), mesh->uvs);
+    else std::cerr << "  Warning: No UVs found for mesh ..." << std::endl;
+    if (mesh->tangents) CalcTangentSpace(*mesh);
+    else std::cerr << "  Warning: No tangents/bitangents found for mesh " << filename << std::endl;
+
+    MeshAsset::Textures textures;
+    if (!ply.texture.empty()) {
+        std::cout << "Info: Found texture: " << TextureTypeToString(aiTextureType_DIFFUSE) << " for mesh " << filename << std::endl;
+        textures.albedo = LoadTexture(ResolveTexturePath(ply.texture));
+    }
+    asset->subMeshes.push_back(std::move(mesh));
+    asset->textures.push_back(textures);
+    return FinishImport(asset, previous, filename, bytes);
+}
+
+// Builds the BLASes of an imported asset, or leaves them to MeshAsset::FinishBLAS when the
+// file is a deformed version of previous
+std::shared_ptr<MeshAsset> TriangleMesh::FinishImport(std::shared_ptr<MeshAsset> asset, const std::shared_ptr<MeshAsset>& previous, const std::string& filename, size_t& bytes) {
+    bytes = 0;
+#if MESH_OPTIMIZE
+    // A deformed version takes the previous version's remap, so its topology still matches
+    auto start = std::chrono::steady_clock::now();
+    MeshOptimizer::Stats stats;
+    int reused = 0;
+    {
+        std::unique_lock<std::mutex> previousLock;
+        if (previous) previousLock = std::unique_lock<std::mutex>(previous->mutex);
+        for (size_t i = 0; i < asset->subMeshes.size(); i++) {
+            const SubMesh* old = previous && i < previous->subMeshes.size() ? previous->subMeshes[i].get() : nullptr;
+            if (old && MeshOptimizer::Reapply(*asset->subMeshes[i], *old)) {
+                reused++;
+                continue;
+            }
+            stats += MeshOptimizer::Optimize(*asset->subMeshes[i]);
+        }
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    if (reused < static_cast<int>(asset->subMeshes.size())) {
+        std::cout << "Optimized " << filename << ": " << stats.vertsBefore << " -> " << stats.vertsAfter << " vertices, "
+                  << stats.trisBefore << " -> " << stats.trisAfter << " triangles (" << stats.degenerate << " degenerate, "
+                  << stats.duplicate << " duplicate) in " << ms << " ms" << std::endl;
+    }
+#endif
+#if MESH_PACKED_ATTRIBUTES
+    for (auto& mesh : asset->subMeshes) mesh->Pack();
+#endif
+    if (previous && asset->SameTopology(*previous)) {
+        asset->previous = previous;
+        asset->blasPending = true;
+    }
+    for (auto& mesh : asset->subMeshes) {
+        if (!asset->blasPending) {
+            if(mesh->BuildBVH()){
+                mesh->bvhReady = true;
+            } else {
+                std::cout << "ERROR: Could not build BVH for mesh: " << filename << std::endl;
+                return nullptr;
+            }
+        }
+        bytes += mesh->GetMemoryBytes();
+    }
+    return asset;
 }
 
 // === Mesh loading with Assimp ===
-bool TriangleMesh::LoadMeshWithAssimp(const std::string& filename, Scene& scene, uint32_t shapeIdx){
+// Imports every submesh of a mesh file with its textures
+std::shared_ptr<MeshAsset> TriangleMesh::LoadMeshWithAssimp(const std::string& filename, const std::shared_ptr<MeshAsset>& previous, size_t& bytes){
     Assimp::Importer importer;
 
-    // NOTE: Assuming flipped winding order for PBRT
-    const aiScene* aiScene = importer.ReadFile(filename,
-        aiProcess_Triangulate | 
-        // aiProcess_GenNormals | 
-        aiProcess_FlipWindingOrder |
-		aiProcess_CalcTangentSpace);
+    const aiScene* aiScene = importer.ReadFile(filename, MESH_IMPORT_FLAGS);
 
     if(!aiScene){
         std::cerr << "Assimp error loading mesh: " << filename << std::endl;
         std::cerr << "Error: " << importer.GetErrorString() << std::endl;
-        return false;
+        return nullptr;
     }
     
     unsigned int numMeshes = aiScene->mNumMeshes;
     if (!aiScene || numMeshes == 0) {
         std::cerr << "Failed to load mesh: " << filename << std::endl;
         std::cerr << "Error: " << importer.GetErrorString() << std::endl;
-        return false;
+        return nullptr;
     }
     
-    // Load submeshes and assign their materials 
+    // Load submeshes and their textures
+    auto asset = std::make_shared<MeshAsset>();
     for(int i = 0; i < numMeshes; i++){
         const aiMesh* aiMesh = aiScene->mMeshes[i];
-        SubMesh* mesh = new SubMesh();
+        auto mesh = std::make_unique<SubMesh>();
+        uint32_t attributes = 0;
+        if (aiMesh->HasNormals()) attributes |= MeshBuffers::Normals;
+        if (aiMesh->HasTextureCoords(0)) attributes |= MeshBuffers::Uvs;
+        if (aiMesh->HasTangentsAndBitangents()) attributes |= MeshBuffers::TangentFrames;
+        mesh->Allocate(aiMesh->mNumVertices, aiMesh->mNumFaces, attributes);
         
         // Load vertices
-        mesh->nVerts = aiMesh->mNumVertices;
-        mesh->vertices = new std::vector<glm::vec4>(mesh->nVerts);
         for (uint32_t i = 0; i < mesh->nVerts; i++) {
-            (*mesh->vertices)[i] = glm::vec4(aiMesh->mVertices[i].x,
+            mesh->vertices[i] = glm::vec4(aiMesh->mVertices[i].x,
                                     aiMesh->mVertices[i].y,
                                     aiMesh->mVertices[i].z,
                                     0.0f);
+            asset->bounds.Grow(glm::vec3(mesh->vertices[i]));
         }
 
         // Load triangle indices
-        mesh->nTris = aiMesh->mNumFaces;
-        mesh->triangles = new std::vector<glm::uvec4>(mesh->nTris);
         for (uint32_t i = 0; i < mesh->nTris; i++) {
             const aiFace& face = aiMesh->mFaces[i];
-            (*mesh->triangles)[i] = glm::uvec4(face.mIndices[0], face.mIndices[1], face.mIndices[2], 0u);
+            mesh->triangles[i] = glm::uvec3(face.mIndices[0], face.mIndices[1], face.mIndices[2]);
         }
         
         // Load normals
-        if (aiMesh->HasNormals()) {
-            mesh->normals = new std::vector<glm::vec3>(mesh->nVerts);
+        if (mesh->normals) {
             for (size_t i = 0; i < mesh->nVerts; i++) {
-                (*mesh->normals)[i] = glm::vec3(aiMesh->mNormals[i].x,
+                mesh->normals[i] = glm::vec3(aiMesh->mNormals[i].x,
                                                 aiMesh->mNormals[i].y,
                                                 aiMesh->mNormals[i].z);
             }
@@ -302,10 +509,9 @@ bool TriangleMesh::LoadMeshWithAssimp(const std::string& filename, Scene& scene,
         }
 
         // Load UV's
-        if (aiMesh->HasTextureCoords(0)) {
-            mesh->uvs = new std::vector<glm::vec2>(mesh->nVerts);
+        if (mesh->uvs) {
             for (size_t i = 0; i < mesh->nVerts; i++) {
-                (*mesh->uvs)[i] = glm::vec2(aiMesh->mTextureCoords[0][i].x,
+                mesh->uvs[i] = glm::vec2(aiMesh->mTextureCoords[0][i].x,
 											aiMesh->mTextureCoords[0][i].y);
             }
         } else {
@@ -313,14 +519,12 @@ bool TriangleMesh::LoadMeshWithAssimp(const std::string& filename, Scene& scene,
         }
 
         // Load TB's
-        if (aiMesh->HasTangentsAndBitangents()) {
-            mesh->tangents = new std::vector<glm::vec3>(mesh->nVerts);
-            mesh->bitangents = new std::vector<glm::vec3>(mesh->nVerts);
+        if (mesh->tangents) {
             for (size_t i = 0; i < mesh->nVerts; i++) {
-                (*mesh->tangents)[i] = glm::vec3(aiMesh->mTangents[i].x,
+                mesh->tangents[i] = glm::vec3(aiMesh->mTangents[i].x,
                     aiMesh->mTangents[i].y,
                     aiMesh->mTangents[i].z);
-                (*mesh->bitangents)[i] = glm::vec3(aiMesh->mBitangents[i].x,
+                mesh->bitangents[i] = glm::vec3(aiMesh->mBitangents[i].x,
                     aiMesh->mBitangents[i].y,
                     aiMesh->mBitangents[i].z);
             }
@@ -329,56 +533,297 @@ bool TriangleMesh::LoadMeshWithAssimp(const std::string& filename, Scene& scene,
             std::cerr << "  Warning: No tangents/bitangents found for mesh " << aiMesh->mName.C_Str() << std::endl;
         }
 
-        // TODO (CRITICAL): Band aid; For now, assume first submesh uses first PBRT material, etc.
-        uint32_t matIdx = shapeIdx + i;
         aiMaterial* aiMat = aiScene->mMaterials[aiMesh->mMaterialIndex];
+        MeshAsset::Textures textures;
+        textures.albedo = LoadTextureWithAssimp(aiMat, aiTextureType_DIFFUSE, aiMesh->mName.C_Str());
+        textures.roughness = LoadTextureWithAssimp(aiMat, aiTextureType_DIFFUSE_ROUGHNESS, aiMesh->mName.C_Str());
+        textures.metallic = LoadTextureWithAssimp(aiMat, aiTextureType_METALNESS, aiMesh->mName.C_Str());
+        textures.normal = LoadTextureWithAssimp(aiMat, aiTextureType_NORMALS, aiMesh->mName.C_Str());
+
+        asset->subMeshes.push_back(std::move(mesh));
+        asset->textures.push_back(textures);
+    }
+    return FinishImport(asset, previous, filename, bytes);
+}
 
-        if (matIdx < (int)scene.materials.size()) {
-            auto disneyMtl = static_cast<DisneyMaterial*>(scene.materials[matIdx]);
-            disneyMtl->albedoTexture = LoadTextureWithAssimp(aiMat, aiTextureType_DIFFUSE, aiMesh->mName.C_Str());
-            disneyMtl->roughnessTexture = LoadTextureWithAssimp(aiMat, aiTextureType_DIFFUSE_ROUGHNESS, aiMesh->mName.C_Str());
-            disneyMtl->metallicTexture = LoadTextureWithAssimp(aiMat, aiTextureType_METALNESS, aiMesh->mName.C_Str());
-            disneyMtl->normalTexture = LoadTextureWithAssimp(aiMat, aiTextureType_NORMALS, aiMesh->mName.C_Str());
-            mesh->materialIndex = matIdx;
-        } else {
-            std::cout << "WARNING: Material index " << matIdx << " out of bounds (scene has " 
-                    << scene.materials.size() << " materials)" << std::endl;
+bool MeshAsset::SameTopology(const MeshAsset& other) const {
+    std::lock_guard<std::mutex> lock(const_cast<MeshAsset&>(other).mutex);
+    if (subMeshes.size() != other.subMeshes.size()) return false;
+    for (size_t i = 0; i < subMeshes.size(); i++) {
+        const SubMesh& a = *subMeshes[i];
+        const SubMesh& b = *other.subMeshes[i];
+        if (a.nVerts != b.nVerts || a.nTris != b.nTris || !a.triangles || !b.triangles) return false;
+        if (!std::equal(a.triangles, a.triangles + a.nTris, b.triangles)) return false;
+    }
+    return true;
+}
+
+// Builds the BLASes of a deformed mesh. Once no scene renders the previous version anymore,
+// its submeshes take the new geometry, copied into their buffers which their BVHs index, and
+// the BVHs are refit; they are rebuilt when the previous version is still in use, its buffers
+// are laid out differently, it was built with spatial splits, or refitting degraded it.
+void MeshAsset::FinishBLAS(int& refit, int& rebuilt) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!blasPending) return;
+    const bool reuse = previous && previous.use_count() == 1;
+    std::unique_lock<std::mutex> previousLock;
+    if (reuse) previousLock = std::unique_lock<std::mutex>(previous->mutex);
+    for (size_t i = 0; i < subMeshes.size(); i++) {
+        if (reuse && previous->subMeshes[i]->SameLayout(*subMeshes[i])) {
+            std::unique_ptr<SubMesh>& old = previous->subMeshes[i];
+            old->CopyFrom(*subMeshes[i]);
+            std::swap(old, subMeshes[i]);
+            if (subMeshes[i]->RefitBVH()) {
+                subMeshes[i]->replicasStale = true;
+                refit++;
+                continue;
+            }
         }
+        subMeshes[i]->replicas.clear();
+        subMeshes[i]->bvhReady = subMeshes[i]->BuildBVH(true);
+        rebuilt++;
+    }
+    previousLock = {};
+    previous.reset();
+    blasPending = false;
+}
 
-        if(mesh->BuildBVH()){
-            mesh->bvhReady = true;
-        } else {
-            std::cout << "ERROR: Could not build BVH for mesh: " << filename << std::endl;
-            return false;
+void TriangleMesh::UpdateBLAS(int& refit, int& rebuilt) {
+    if (!asset) return;
+    asset->FinishBLAS(refit, rebuilt);
+    for (size_t i = 0; i < meshes.size(); i++) meshes[i] = asset->subMeshes[i].get();
+}
+
+// === Mesh buffers ===
+void MeshBuffers::Allocate(uint32_t nVerts, uint32_t nTris, uint32_t attributes) {
+    // Array sizes in vec4s, so every array starts 16 byte aligned
+    auto units = [](size_t bytes) { return (bytes + sizeof(glm::vec4) - 1) / sizeof(glm::vec4); };
+    const size_t vec3s = units(size_t(nVerts) * sizeof(glm::vec3));
+    const size_t vec2s = units(size_t(nVerts) * sizeof(glm::vec2));
+    const size_t indices = units(size_t(nTris) * sizeof(glm::uvec3));
+    const size_t records = units(size_t(nVerts) * sizeof(PackedVertex));
+    const bool full = !(attributes & Packed);
+    const bool fullUvs = (attributes & Uvs) && (full || (attributes & FullUvs));
+    storageSize = nVerts + indices + (full ? 0 : records) +
+        (full && (attributes & Normals) ? vec3s : 0) +
+        (full && (attributes & TangentFrames) ? 2 * vec3s : 0) +
+        (fullUvs ? vec2s : 0);
+    storage.reset(new glm::vec4[storageSize]);
+
+    glm::vec4* next = storage.get();
+    auto take = [&next](size_t count) { glm::vec4* array = next; next += count; return array; };
+    this->nVerts = nVerts;
+    this->nTris = nTris;
+    this->attributes = attributes;
+    vertices = take(nVerts);
+    triangles = reinterpret_cast<glm::uvec3*>(take(indices));
+    packed = full ? nullptr : reinterpret_cast<PackedVertex*>(take(records));
+    normals = full && (attributes & Normals) ? reinterpret_cast<glm::vec3*>(take(vec3s)) : nullptr;
+    tangents = full && (attributes & TangentFrames) ? reinterpret_cast<glm::vec3*>(take(vec3s)) : nullptr;
+    bitangents = full && (attributes & TangentFrames) ? reinterpret_cast<glm::vec3*>(take(vec3s)) : nullptr;
+    uvs = fullUvs ? reinterpret_cast<glm::vec2*>(take(vec2s)) : nullptr;
+}
+
+// Octahedral encoding of unit vectors, two 16 bit snorms
+static uint32_t EncodeOctahedral(const glm::vec3& d) {
+    glm::vec2 p = glm::vec2(d) / (std::abs(d.x) + std::abs(d.y) + std::abs(d.z) + 1e-30f);
+    if (d.z < 0.0f) {
+        p = glm::vec2((1.0f - std::abs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f),
+                      (1.0f - std::abs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+    }
+    auto snorm = [](float x) { return static_cast<uint32_t>(static_cast<uint16_t>(static_cast<int16_t>(std::lround(glm::clamp(x, -1.0f, 1.0f) * 32767.0f)))); };
+    return snorm(p.x) | (snorm(p.y) << 16);
+}
+
+static glm::vec3 DecodeOctahedral(uint32_t e) {
+    auto snorm = [](uint32_t bits) { return std::max(static_cast<float>(static_cast<int16_t>(bits & 0xffff)) * (1.0f / 32767.0f), -1.0f); };
+    glm::vec3 d(snorm(e), snorm(e >> 16), 0.0f);
+    d.z = 1.0f - std::abs(d.x) - std::abs(d.y);
+    float t = std::max(-d.z, 0.0f);
+    d.x += d.x >= 0.0f ? -t : t;
+    d.y += d.y >= 0.0f ? -t : t;
+    return glm::normalize(d);
+}
+
+void MeshBuffers::Pack() {
+    if (attributes & Packed) return;
+    glm::vec2 uvMin(0.0f), uvExtent(0.0f);
+    if (uvs && nVerts > 0) {
+        glm::vec2 hi = uvMin = uvs[0];
+        for (uint32_t i = 1; i < nVerts; i++) {
+            uvMin = glm::min(uvMin, uvs[i]);
+            hi = glm::max(hi, uvs[i]);
         }
+        uvExtent = hi - uvMin;
+    }
+    const bool fullUvs = uvs && glm::max(uvExtent.x, uvExtent.y) > PACKED_UV_MAX_EXTENT;
 
-        meshes.push_back(mesh);
+    MeshBuffers out;
+    out.Allocate(nVerts, nTris, attributes | Packed | (fullUvs ? FullUvs : 0));
+    std::memcpy(out.vertices, vertices, size_t(nVerts) * sizeof(glm::vec4));
+    std::memcpy(out.triangles, triangles, size_t(nTris) * sizeof(glm::uvec3));
+    if (fullUvs) std::memcpy(out.uvs, uvs, size_t(nVerts) * sizeof(glm::vec2));
+    else {
+        out.uvMin = uvMin;
+        out.uvExtent = uvExtent;
     }
-    return true;
+    for (uint32_t i = 0; i < nVerts; i++) {
+        PackedVertex& record = out.packed[i];
+        const glm::vec3 n = normals ? normals[i] : glm::vec3(0.0f, 0.0f, 1.0f);
+        record.normal = EncodeOctahedral(n);
+        record.tangent = 0;
+        if (tangents) {
+            // Made orthogonal to the normal, the bitangent is rebuilt as their cross product
+            glm::vec3 t = tangents[i] - n * glm::dot(n, tangents[i]), b;
+            if (glm::dot(t, t) < 1e-20f) Utils::Orthonormals(n, t, b);
+            else t = glm::normalize(t);
+            const bool flipped = glm::dot(glm::cross(n, t), bitangents[i]) < 0.0f;
+            record.tangent = (EncodeOctahedral(t) & ~1u) | (flipped ? 1u : 0u);
+        }
+        for (int k = 0; k < 2; k++) {
+            float x = uvs && !fullUvs && out.uvExtent[k] > 0.0f ? (uvs[i][k] - out.uvMin[k]) / out.uvExtent[k] : 0.0f;
+            record.uv[k] = static_cast<uint16_t>(std::lround(glm::clamp(x, 0.0f, 1.0f) * 65535.0f));
+        }
+    }
+    *this = std::move(out);
+}
+
+void MeshBuffers::Interpolate(const glm::uvec3& tri, float u, float v, glm::vec3& n, glm::vec3& t, glm::vec3& b, glm::vec2& uv) const {
+    const float w = 1.0f - u - v;
+    t = b = glm::vec3(0.0f);
+    uv = glm::vec2(0.0f);
+    if (packed) {
+        const PackedVertex& p0 = packed[tri.x];
+        const PackedVertex& p1 = packed[tri.y];
+        const PackedVertex& p2 = packed[tri.z];
+        n = glm::normalize(w * DecodeOctahedral(p0.normal) + u * DecodeOctahedral(p1.normal) + v * DecodeOctahedral(p2.normal));
+        if (attributes & TangentFrames) {
+            auto bitangent = [](const PackedVertex& p, const glm::vec3& tangent) {
+                return glm::cross(DecodeOctahedral(p.normal), tangent) * ((p.tangent & 1u) ? -1.0f : 1.0f);
+            };
+            glm::vec3 t0 = DecodeOctahedral(p0.tangent), t1 = DecodeOctahedral(p1.tangent), t2 = DecodeOctahedral(p2.tangent);
+            t = glm::normalize(w * t0 + u * t1 + v * t2);
+            b = glm::normalize(w * bitangent(p0, t0) + u * bitangent(p1, t1) + v * bitangent(p2, t2));
+        }
+        if (uvs) uv = w * uvs[tri.x] + u * uvs[tri.y] + v * uvs[tri.z];
+        else if (attributes & Uvs) {
+            glm::vec2 q = w * glm::vec2(p0.uv[0], p0.uv[1]) + u * glm::vec2(p1.uv[0], p1.uv[1]) + v * glm::vec2(p2.uv[0], p2.uv[1]);
+            uv = uvMin + q * (1.0f / 65535.0f) * uvExtent;
+        }
+        return;
+    }
+    n = glm::normalize(w * normals[tri.x] + u * normals[tri.y] + v * normals[tri.z]);
+    if (tangents && bitangents) {
+        t = glm::normalize(w * tangents[tri.x] + u * tangents[tri.y] + v * tangents[tri.z]);
+        b = glm::normalize(w * bitangents[tri.x] + u * bitangents[tri.y] + v * bitangents[tri.z]);
+    }
+    if (uvs) uv = w * uvs[tri.x] + u * uvs[tri.y] + v * uvs[tri.z];
+}
+
+bool MeshBuffers::SameLayout(const MeshBuffers& other) const {
+    return nVerts == other.nVerts && nTris == other.nTris && GetAttributes() == other.GetAttributes();
+}
+
+void MeshBuffers::CopyFrom(const MeshBuffers& other) {
+    if (!SameLayout(other) || !storage) Allocate(other.nVerts, other.nTris, other.GetAttributes());
+    if (storageSize > 0) std::memcpy(storage.get(), other.storage.get(), storageSize * sizeof(glm::vec4));
+    uvMin = other.uvMin;
+    uvExtent = other.uvExtent;
+}
+
+void MeshBuffers::Swap(MeshBuffers& other) noexcept {
+    std::swap(nTris, other.nTris);
+    std::swap(nVerts, other.nVerts);
+    std::swap(vertices, other.vertices);
+    std::swap(triangles, other.triangles);
+    std::swap(normals, other.normals);
+    std::swap(tangents, other.tangents);
+    std::swap(bitangents, other.bitangents);
+    std::swap(uvs, other.uvs);
+    std::swap(packed, other.packed);
+    std::swap(uvMin, other.uvMin);
+    std::swap(uvExtent, other.uvExtent);
+    std::swap(storage, other.storage);
+    std::swap(storageSize, other.storageSize);
+    std::swap(attributes, other.attributes);
 }
 
 // === BVH Construction ===
-bool SubMesh::BuildBVH()
+// refittable builds without spatial splits, faster and Refit compatible, for deforming meshes
+// The BVH indexes the vertices through the triangles, both must stay where they are while it
+// is in use
+bool SubMesh::BuildBVH(bool refittable)
+{
+    if (!ValidateTriangles()) return false;
+    const auto* v = reinterpret_cast<const tinybvh::bvhvec4*>(vertices);
+    const auto* indices = reinterpret_cast<const uint32_t*>(triangles);
+    if (refittable) {
+        bvh.Build(v, indices, nTris);
+        buildCost = bvh.bvh.SAHCost();
+    }
+    else bvh.BuildHQ(v, indices, nTris);
+    this->refittable = refittable;
+    return true;
+}
+
+// Refits the BVH after the vertices changed in place. False when it cannot be refit or its
+// SAH cost grew past BLAS_REBUILD_SAH_RATIO, the caller rebuilds it then.
+bool SubMesh::RefitBVH()
+{
+    if (!bvhReady || !refittable) return false;
+    bvh.bvh.Refit();
+    if (bvh.bvh.SAHCost() > buildCost * BLAS_REBUILD_SAH_RATIO) return false;
+    bvh.ConvertFrom(bvh.bvh);
+    return true;
+}
+
+bool SubMesh::ValidateTriangles() const
 {
     if (!vertices || !triangles) return false;
     if (nVerts == 0 || nTris == 0) return false;
-    if (vertices->size() < nVerts) return false;
-    if (triangles->size() < nTris) return false;
-
-    bvhTriSoup.resize(size_t(nTris) * 3ull);
 
     for (uint32_t i = 0; i < nTris; i++)
     {
-        const glm::uvec4 t = (*triangles)[i];
+        const glm::uvec3& t = triangles[i];
         if (t.x >= nVerts || t.y >= nVerts || t.z >= nVerts) return false;
-
-        const size_t base = size_t(i) * 3ull;
-        bvhTriSoup[base + 0] = (*vertices)[t.x];
-        bvhTriSoup[base + 1] = (*vertices)[t.y];
-        bvhTriSoup[base + 2] = (*vertices)[t.z];
     }
-
-    bvh.BuildHQ(reinterpret_cast<const tinybvh::bvhvec4*>(bvhTriSoup.data()), nTris);
     return true;
 }
 
+// Geometry and BLAS, replicas excluded
+size_t SubMesh::GetMemoryBytes() const {
+    return GetBytes() +
+        (remap ? (remap->vertexSource.size() + remap->vertexMap.size() + remap->triangleSource.size()) * sizeof(uint32_t) : 0) +
+        size_t(bvh.usedNodes) * sizeof(tinybvh::BVH_SoA::BVHNode);
+}
+
+// Copies the attributes for one NUMA node, call from a thread bound to that node. The BVH is
+// built over the copy with the builder of the original rather than converted from it, as
+// tinybvh's conversion keeps pointing at the original's indices and vertices; this way the
+// replica owns all of its memory.
+void SubMesh::BuildReplica(int node)
+{
+    if (!bvhReady || node < 1) return;
+    auto replica = std::make_unique<SubMeshReplica>();
+    replica->CopyFrom(*this);
+    const auto* v = reinterpret_cast<const tinybvh::bvhvec4*>(replica->vertices);
+    const auto* indices = reinterpret_cast<const uint32_t*>(replica->triangles);
+    if (refittable) replica->bvh.Build(v, indices, nTris);
+    else replica->bvh.BuildHQ(v, indices, nTris);
+    replicas[node - 1] = std::move(replica);
+}
+
+// Takes the original's deformed vertices into the replica's buffers, which its BVH indexes,
+// and refits the BVH, call from a thread bound to the node. Built anew when it cannot be refit.
+void SubMesh::RefitReplica(int node)
+{
+    if (!bvhReady || node < 1) return;
+    SubMeshReplica* replica = replicas[node - 1].get();
+    if (!replica || !refittable || !replica->SameLayout(*this)) {
+        BuildReplica(node);
+        return;
+    }
+    replica->CopyFrom(*this);
+    replica->bvh.bvh.Refit();
+    replica->bvh.ConvertFrom(replica->bvh.bvh);
+}
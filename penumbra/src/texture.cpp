@@ -1,34 +1,78 @@
 #include "texture.h"
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include "glm/gtc/packing.hpp"
+
 // #include "materials.h"
 
+// 8 bit texels to float, the values a float read of the file gives
+static const std::array<float, 256> byteToFloat = [] {
+    std::array<float, 256> lut;
+    for (int i = 0; i < 256; i++) lut[i] = static_cast<float>(i) / 255.0f;
+    return lut;
+}();
+
 Texture::Texture() {}
 Texture::~Texture() {}
 
-bool Texture::Load(const std::string& path){
+bool Texture::Load(const std::string& path, int channels){
     this->path = path;
 
-    // Load image data
-    if(!Image::LoadImage(path.c_str(), pixels, xres, yres, nchannels)){
+    // Load image data, colors keep RGB (alpha is never sampled)
+#if TEXTURE_CACHE
+    int fileChannels = 0;
+    file = TextureCache::Get().Open(path, xres, yres, fileChannels);
+    if (!file) {
         std::cerr << "Failed to load texture: " << path << std::endl;
         return false;
     }
+    nchannels = std::min(fileChannels, channels == 1 ? 1 : 3);
+#else
+    if(!Image::LoadImage(path.c_str(), texels, xres, yres, nchannels, format, channels == 1 ? 1 : 3, TEXTURE_COMPACT)){
+        std::cerr << "Failed to load texture: " << path << std::endl;
+        return false;
+    }
+#endif
     return true;
 }
 
+inline float Texture::Texel(size_t i) const {
+    switch (format) {
+    case Image::Format::U8: return byteToFloat[texels[i]];
+    case Image::Format::Half: {
+        uint16_t h;
+        std::memcpy(&h, texels.data() + i * sizeof(uint16_t), sizeof(h));
+        return glm::unpackHalf1x16(h);
+    }
+    default: {
+        float f;
+        std::memcpy(&f, texels.data() + i * sizeof(float), sizeof(f));
+        return f;
+    }
+    }
+}
+
 glm::vec3 Texture::Sample(const glm::vec2& uv) const {
     // Sample the texture at the given UV coordinates
-    if (pixels.empty()) return glm::vec3(0.0f);
+    if (texels.empty() && !file) return glm::vec3(0.0f);
 
     // Convert UV coordinates to pixel coordinates
     int x = static_cast<int>(uv.x * xres);
     int y = static_cast<int>((1.0f - uv.y) * yres);
     if (x < 0 || x >= xres || y < 0 || y >= yres) return glm::vec3(0.0f);
 
-    // Get the pixel color
-    int index = (y * xres + x) * nchannels;
-    if (index + 2 >= pixels.size()) return glm::vec3(0.0f);
-    return glm::vec3(pixels[index], pixels[index + 1], pixels[index + 2]);
+    // Get the pixel color, one channel images are gray
+    if (file) {
+        float texel[3] = { 0.0f, 0.0f, 0.0f };
+        if (!TextureCache::Get().Lookup(file, x, y, nchannels, texel)) return glm::vec3(0.0f);
+        return nchannels < 3 ? glm::vec3(texel[0]) : glm::vec3(texel[0], texel[1], texel[2]);
+    }
+    size_t index = (size_t(y) * xres + x) * nchannels;
+    if (nchannels < 3) return glm::vec3(Texel(index));
+    return glm::vec3(Texel(index), Texel(index + 1), Texel(index + 2));
 }
 
 #pragma once
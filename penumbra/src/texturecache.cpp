@@ -0,0 +1,81 @@
+#include "texturecache.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include <OpenImageIO/imagecache.h>
+
+struct TextureCache::Impl {
+    std::shared_ptr<OIIO::ImageCache> cache;
+    size_t capacity = 0;
+};
+
+// Statistics are 64 or 32 bit depending on the OIIO version
+static uint64_t Stat(const OIIO::ImageCache& cache, const char* name) {
+    long long v64 = 0;
+    if (cache.getattribute(name, OIIO::TypeDesc::INT64, &v64)) return static_cast<uint64_t>(v64);
+    int v = 0;
+    if (cache.getattribute(name, OIIO::TypeDesc::INT, &v)) return static_cast<uint64_t>(v);
+    return 0;
+}
+
+TextureCache::TextureCache() : impl(std::make_unique<Impl>()) {
+    // Private rather than OIIO's shared cache, so its budget is ours alone
+#if OIIO_VERSION_MAJOR >= 3
+    impl->cache = OIIO::ImageCache::create(false);
+#else
+    impl->cache = std::shared_ptr<OIIO::ImageCache>(OIIO::ImageCache::create(false),
+                                                    [](OIIO::ImageCache* cache) { OIIO::ImageCache::destroy(cache); });
+#endif
+    impl->cache->attribute("autotile", TEXTURE_CACHE_TILE_SIZE);
+    impl->cache->attribute("automip", 1);
+    impl->cache->attribute("accept_untiled", 1);
+    SetCapacity(size_t(TEXTURE_CACHE_DEFAULT_MB) << 20);
+}
+
+TextureCache::~TextureCache() = default;
+
+TextureCache& TextureCache::Get() {
+    static TextureCache cache;
+    return cache;
+}
+
+TextureCache::File* TextureCache::Open(const std::string& path, int& xres, int& yres, int& nchannels) {
+    OIIO::ImageCache& cache = *impl->cache;
+    OIIO::ustring name(path);
+    cache.invalidate(name, false); // Only when the file changed since its tiles were read
+
+    int resolution[2] = { 0, 0 };
+    if (!cache.get_image_info(name, 0, 0, OIIO::ustring("resolution"), OIIO::TypeDesc(OIIO::TypeDesc::INT, 2), resolution) ||
+        !cache.get_image_info(name, 0, 0, OIIO::ustring("channels"), OIIO::TypeDesc::INT, &nchannels)) {
+        std::cout << "OIIO image cache error: " << cache.geterror() << std::endl;
+        return nullptr;
+    }
+    xres = resolution[0];
+    yres = resolution[1];
+    return reinterpret_cast<File*>(cache.get_image_handle(name));
+}
+
+bool TextureCache::Lookup(File* file, int x, int y, int nchannels, float* out) const {
+    OIIO::ImageCache& cache = *impl->cache;
+    // The thread's Perthread holds its micro-cache of recently used tiles
+    return cache.get_pixels(reinterpret_cast<OIIO::ImageCache::ImageHandle*>(file), cache.get_perthread_info(),
+                            0, 0, x, x + 1, y, y + 1, 0, 1, 0, nchannels, OIIO::TypeDesc::FLOAT, out);
+}
+
+void TextureCache::SetCapacity(size_t bytes) {
+    impl->capacity = bytes;
+    impl->cache->attribute("max_memory_MB", std::max(static_cast<float>(bytes) / float(1 << 20), 1.0f));
+}
+
+TextureCache::Stats TextureCache::GetStats() const {
+    const OIIO::ImageCache& cache = *impl->cache;
+    Stats stats;
+    stats.lookups = Stat(cache, "stat:find_tile_calls");
+    stats.microMisses = Stat(cache, "stat:find_tile_microcache_misses");
+    stats.misses = Stat(cache, "stat:find_tile_cache_misses");
+    stats.bytesRead = Stat(cache, "stat:bytes_read");
+    stats.bytes = static_cast<size_t>(Stat(cache, "stat:cache_memory_used"));
+    stats.capacity = impl->capacity;
+    return stats;
+}
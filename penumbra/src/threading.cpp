@@ -1,120 +1,244 @@
 #include "threading.h"
 
-//RenderThreadPool::RenderThreadPool(Scene* scene, int nThreads, int w, int h)
-//    : scene(scene), nThreads(nThreads), w(w), h(h),
-//    activeThreads(0), stop(false), tiles(0), tileSize(TILESIZE),
-//    tilesW(0), tilesH(0) {
-//    // Force body to exist
-//    (void)this;
-//}
+RenderThreadPool::RenderThreadPool(int nThreads)
+    : nThreads(std::max(1, nThreads)), activeThreads(0), stop(false) {
+    frameFinished = true;
+    SpawnWorkers();
+}
 
-RenderThreadPool::~RenderThreadPool() { Stop(); }
+RenderThreadPool::~RenderThreadPool() {
+    Stop();
+    JoinWorkers();
+}
 
-// Helper function: Generates archimedean spiral grid
-std::vector<std::vector<int>> GenerateSpiralTilemap(int w, int h, int tileSize) {
-    enum direction { right, down, left, up };
-    direction dir = right;
+void RenderThreadPool::SpawnWorkers() {
+    shutdown = false;
+    queues.clear();
+    for (int i = 0; i < nThreads; i++) queues.push_back(std::make_unique<WorkQueue>());
+    finishTimes.assign(nThreads, std::chrono::steady_clock::time_point());
+    AssignNodes();
+    for (int i = 1; i < nThreads; i++) {
+        workers.emplace_back(&RenderThreadPool::WorkerLoop, this, i, jobId);
+    }
+}
 
+void RenderThreadPool::JoinWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        shutdown = true;
+    }
+    jobCv.notify_all();
+    for (auto& t : workers) {
+        if (t.joinable()) t.join();
+    }
+    workers.clear();
+}
+
+// Changes the thread count, between frames only
+void RenderThreadPool::Resize(int nThreads) {
+    nThreads = std::max(1, nThreads);
+    if (nThreads == this->nThreads) return;
+    std::lock_guard<std::mutex> frameLock(frameMutex);
+    JoinWorkers();
+    this->nThreads = nThreads;
+    SpawnWorkers();
+}
+
+// Slots are split into contiguous ranges, one per node
+void RenderThreadPool::AssignNodes() {
+    nodes = std::max(1, std::min(Numa::NodeCount(), nThreads));
+    slotNode.resize(nThreads);
+    for (int i = 0; i < nThreads; i++) slotNode[i] = i * nodes / nThreads;
+    placementVersion++;
+}
+
+// Re-reads the NUMA topology, between frames only. A no-op on a single node without pinning.
+void RenderThreadPool::SetPlacement(bool pinThreads) {
+    std::lock_guard<std::mutex> frameLock(frameMutex);
+    std::lock_guard<std::mutex> lock(jobMutex);
+    this->pinThreads = pinThreads;
+    AssignNodes();
+}
+
+// Applies the slot's affinity to the calling thread. placed tracks whether the thread was
+// bound before, so it can be released when placement is turned off.
+void RenderThreadPool::PlaceThread(int slot, bool& placed) {
+    Numa::SetCurrentNode(slotNode[slot]);
+    if (pinThreads) {
+        int first = slot;
+        while (first > 0 && slotNode[first - 1] == slotNode[slot]) first--;
+        const std::vector<int>& cpus = Numa::NodeCpus(slotNode[slot]);
+        Numa::PinCurrentThread(cpus[(slot - first) % cpus.size()]);
+        placed = true;
+    }
+    else if (nodes > 1) {
+        Numa::BindCurrentThreadToNode(slotNode[slot]);
+        placed = true;
+    }
+    else if (placed) {
+        Numa::BindCurrentThreadToNode(-1);
+        placed = false;
+    }
+}
+
+// Helper function: Generates the tile grid, tiles are listed in the given traversal order
+std::vector<Tile> GenerateTilemap(int w, int h, int tileSize, TileOrder order) {
     const int tilesW = (w + tileSize - 1) / tileSize;
     const int tilesH = (h + tileSize - 1) / tileSize;
 
-    int tx = (tilesW - 1) / 2;
-    int ty = (tilesH - 1) / 2;
-
-    std::vector<std::vector<int>> tiles(tilesW * tilesH);
-    std::vector<int> order;
-
-    unsigned int iter = 0;
-    unsigned int turns = 0;
-    unsigned int len = 1;
-
-    while (iter < tilesW * tilesH) {
-        if (ty >= 0 && ty < tilesH && tx >= 0 && tx < tilesW) {
-            int tileIndex = ty * tilesW + tx;
-            order.push_back(tileIndex);
-            for (int px = tx * tileSize; px < tx * tileSize + tileSize; px++) {
-                for (int py = ty * tileSize; py < ty * tileSize + tileSize; py++) {
-                    if (px < w && py < h)
-                        tiles[tileIndex].push_back(py * w + px);
-                }
+    std::vector<Tile> tiles;
+    tiles.reserve(tilesW * tilesH);
+    TraverseGrid(tilesW, tilesH, order, [&](int tx, int ty) {
+        Tile tile;
+        tile.x0 = tx * tileSize;
+        tile.y0 = ty * tileSize;
+        tile.x1 = std::min(w, tile.x0 + tileSize);
+        tile.y1 = std::min(h, tile.y0 + tileSize);
+        tile.index = static_cast<int>(tiles.size());
+        tiles.push_back(tile);
+    });
+    return tiles;
+}
+
+// seen is the job current at spawn time, so respawned workers skip finished frames
+void RenderThreadPool::WorkerLoop(int slot, uint64_t seen) {
+    uint64_t placedVersion = 0;
+    bool placed = false;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(jobMutex);
+            jobCv.wait(lock, [&] { return shutdown || jobId != seen; });
+            if (shutdown) return;
+            seen = jobId;
+            if (placedVersion != placementVersion) {
+                PlaceThread(slot, placed);
+                placedVersion = placementVersion;
             }
-            if(SHUFFLE) std::shuffle(tiles[tileIndex].begin(), tiles[tileIndex].end(), std::mt19937{ std::random_device{}() });
-            iter++;
         }
+        if (forBody) ForWorker();
+        else RenderWorker(slot);
+        FinishJob();
+    }
+}
+
+void RenderThreadPool::ForWorker() {
+    for (int i; !stop && (i = forNext.fetch_add(1, std::memory_order_relaxed)) < forCount;) (*forBody)(i);
+}
 
-        switch (dir) {
-        case right:
-            tx++;
-            if (--len == 0) { dir = down; turns++; len = (turns / 2) + 1; }
-            break;
-        case down:
-            ty++;
-            if (--len == 0) { dir = left; turns++; len = (turns / 2) + 1; }
-            break;
-        case left:
-            tx--;
-            if (--len == 0) { dir = up; turns++; len = (turns / 2) + 1; }
-            break;
-        case up:
-            ty--;
-            if (--len == 0) { dir = right; turns++; len = (turns / 2) + 1; }
-            break;
+void RenderThreadPool::RenderWorker(int slot) {
+    Tile tile;
+    bool idle = false;
+    while (!stop && outstanding.load(std::memory_order_acquire) > 0) {
+        if (PopLocal(slot, tile) || Steal(slot, tile)) {
+            if (idle) {
+                idleThreads.fetch_sub(1, std::memory_order_relaxed);
+                idle = false;
+            }
+            ProcessTile(slot, tile);
+            if (outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1) WakeIdle(true);
+        }
+        else {
+            // Nothing queued. Sleep until a busy thread splits its tile for us or the job ends.
+            if (!idle) {
+                idleThreads.fetch_add(1, std::memory_order_relaxed);
+                idle = true;
+            }
+            std::unique_lock<std::mutex> lock(idleMutex);
+            idleCv.wait(lock, [&] {
+                return stop || outstanding.load(std::memory_order_acquire) == 0 || queued.load(std::memory_order_acquire) > 0;
+            });
         }
     }
+    if (idle) idleThreads.fetch_sub(1, std::memory_order_relaxed);
+    finishTimes[slot] = std::chrono::steady_clock::now();
+}
 
-    std::vector<std::vector<int>> spiralTiles;
-    spiralTiles.reserve(order.size());
-    for (int i : order)
-        spiralTiles.push_back(std::move(tiles[i]));
-
-    return spiralTiles;
+// Hands the kernel the whole tile in one call, the kernel offers what it has not rendered yet
+// to idle threads as it goes
+void RenderThreadPool::ProcessTile(int slot, Tile tile) {
+    auto start = std::chrono::steady_clock::now();
+    if (tile.stepEnd < 0) tile.stepEnd = TileSteps(tile);
+    TileSplitter splitter(*this, slot, tile);
+    if (!stop) kernel->RenderTile(tile, splitter);
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    tileCost[tile.index].fetch_add(static_cast<uint64_t>(ns), std::memory_order_relaxed);
 }
 
-static inline int MortonEncode2D(int x, int y) {
-    int morton = 0;
-    for (int i = 0; i < 16; i++) {
-        morton |= ((x & (1 << i)) << i) | ((y & (1 << i)) << (i + 1));
+// While more threads are idle than there are queued tiles, and enough steps are left, the
+// back half of [cursor, stepEnd) is queued on our deque for an idle thread to steal
+int TileSplitter::Offer(int cursor) {
+    if (pool.stop) return cursor;
+    while (pool.idleThreads.load(std::memory_order_relaxed) > pool.queued.load(std::memory_order_relaxed) &&
+           tile.stepEnd - cursor >= 2 * TILE_SPLIT_MIN) {
+        Tile back = tile;
+        back.stepBegin = SplitSteps(cursor, tile.stepEnd, tile.pixelOrder);
+        tile.stepEnd = back.stepBegin;
+        pool.outstanding.fetch_add(1, std::memory_order_acq_rel);
+        pool.Push(slot, back);
+        pool.splits.fetch_add(1, std::memory_order_relaxed);
     }
-    return morton;
+    return tile.stepEnd;
 }
 
-// Morton (Z-order) encoding for better cache coherence
-// https://en.wikipedia.org/wiki/Z-order_curve
-void RenderThreadPool::PrecomputeMortonOrder() {
-    for (auto& tile_pixels : grid) {
-        std::sort(tile_pixels.begin(), tile_pixels.end(), [this](int a, int b) {
-            int ax = a % w;
-            int ay = a / w;
-            int bx = b % w;
-            int by = b / w;
-            return MortonEncode2D(ax, ay) < MortonEncode2D(bx, by);
-        });
+void RenderThreadPool::Push(int slot, const Tile& tile) {
+    {
+        std::lock_guard<std::mutex> lock(queues[slot]->mutex);
+        queues[slot]->items.push_back(tile);
+        queued.fetch_add(1, std::memory_order_acq_rel);
     }
+    WakeIdle(false);
 }
 
-void RenderThreadPool::RenderWorker(std::function<void(int, int)> render) {
+// Taking idleMutex orders the wake up after the sleepers' check of their condition
+void RenderThreadPool::WakeIdle(bool all) {
     {
-        std::lock_guard<std::mutex> lock(printMutex);
-        int currenttotal = ++activeThreads;
+        std::lock_guard<std::mutex> lock(idleMutex);
     }
+    if (all) idleCv.notify_all();
+    else idleCv.notify_one();
+}
+
+bool RenderThreadPool::PopLocal(int slot, Tile& tile) {
+    WorkQueue& q = *queues[slot];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.items.empty()) return false;
+    tile = q.items.front();
+    q.items.pop_front();
+    queued.fetch_sub(1, std::memory_order_acq_rel);
+    return true;
+}
 
-    int idx;
-    while (!stop && (idx = tiles.fetch_add(1, std::memory_order_relaxed)) < tilesW * tilesH) {
-        std::vector<int>& pixels = grid[idx];
-        for(int pixelidx : pixels){
-            int u = pixelidx % w;
-            int v = pixelidx / w;
-            render(u, v);
+// Visits the other deques starting next to our own, taking from the back.
+// Deques of threads on our node are tried first.
+bool RenderThreadPool::Steal(int slot, Tile& tile) {
+    for (int remote = 0; remote < (nodes > 1 ? 2 : 1); remote++) {
+        for (int k = 1; k < nThreads; k++) {
+            int victim = (slot + k) % nThreads;
+            if ((slotNode[victim] != slotNode[slot]) != (remote == 1)) continue;
+            WorkQueue& q = *queues[victim];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.items.empty()) continue;
+            tile = q.items.back();
+            q.items.pop_back();
+            queued.fetch_sub(1, std::memory_order_acq_rel);
+            steals.fetch_add(1, std::memory_order_relaxed);
+            if (remote) remoteSteals.fetch_add(1, std::memory_order_relaxed);
+            return true;
         }
     }
+    return false;
+}
 
-    {
-        std::lock_guard<std::mutex> lock(printMutex);
-        int currenttotal = --activeThreads;
-        if(currenttotal == 0){
-            PrintStats();
+void RenderThreadPool::FinishJob() {
+    std::lock_guard<std::mutex> lock(printMutex);
+    int currenttotal = --activeThreads;
+    if(currenttotal == 0){
+        if (verbose && !forBody) PrintStats();
+        {
+            std::lock_guard<std::mutex> jobLock(jobMutex);
             frameFinished = true;
         }
+        doneCv.notify_all();
     }
 }
 
@@ -167,49 +291,179 @@ void RenderThreadPool::PrintStats() {
         << c(NUM) << fmtDuration(static_cast<long long>(msTotal)) << c(RST)
         << c(DIM) << "  (" << c(RST) << c(NUM) << msTotal << c(RST) << c(DIM) << " ms)" << c(RST)
         << "\n";
-    std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Shuffle tiles"
+    // Time threads spent waiting for the last tiles, relative to the whole frame
+    double tailIdle = 0.0;
+    const auto frameNs = std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count();
+    if (frameNs > 0) {
+        for (const auto& t : finishTimes) {
+            tailIdle += static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - t).count());
+        }
+        tailIdle = 100.0 * std::max(0.0, tailIdle) / (static_cast<double>(frameNs) * nThreads);
+    }
+    std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Tail idle time"
         << c(RST) << c(DIM) << ": " << c(RST)
-        << (SHUFFLE ? (std::string(c(OK)) + "ENABLED" + c(RST)) : "DISABLED")
+        << c(NUM) << std::fixed << std::setprecision(1) << tailIdle << "%" << c(RST) << std::defaultfloat
         << "\n";
-    std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Morton ordering"
+    std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Steals / splits"
         << c(RST) << c(DIM) << ": " << c(RST)
-        << (MORTON_ORDERING ? (std::string(c(OK)) + "ENABLED" + c(RST)) : "DISABLED")
+        << c(NUM) << steals.load() << c(RST) << c(DIM) << " / " << c(RST)
+        << c(NUM) << splits.load() << c(RST)
+        << "\n";
+    if (nodes > 1) {
+        std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "NUMA nodes"
+            << c(RST) << c(DIM) << ": " << c(RST)
+            << c(NUM) << nodes << c(RST) << c(DIM) << "  (" << c(RST)
+            << c(NUM) << remoteSteals.load() << c(RST) << c(DIM) << " remote steals)" << c(RST)
+            << "\n";
+    }
+    std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Tile size"
+        << c(RST) << c(DIM) << ": " << c(RST)
+        << c(NUM) << tileSize << c(RST) << "\n";
+    std::cout << "  " << c(KEY) << std::left << std::setw(KW) << "Tile / pixel order"
+        << c(RST) << c(DIM) << ": " << c(RST)
+        << c(NUM) << TileOrderName(tileOrder) << c(RST) << c(DIM) << " / " << c(RST)
+        << c(NUM) << TileOrderName(pixelOrder) << c(RST)
         << "\n";
     std::cout << c(LINE) << "  ==================================================" << c(RST) << "\n";
 }
 
-void RenderThreadPool::Start(std::function<void(int, int)> render) {
-    tiles = 0;
-    grid = GenerateSpiralTilemap(w, h, tileSize);
-    if(MORTON_ORDERING) PrecomputeMortonOrder();
+// Forgets the measured tile costs, the next job starts in tile order again
+void RenderThreadPool::ResetTileCosts() {
+    std::lock_guard<std::mutex> frameLock(frameMutex);
+    hasTileCosts = false;
+    for (size_t i = 0; i < grid.size() * views; i++) tileCost[i] = 0;
+}
 
-    // TODO: Avoid this code repetition
-    tilesW = (w + tileSize - 1) / tileSize;
-    tilesH = (h + tileSize - 1) / tileSize;
+// Tile side and traversal orders for the next jobs, the grid is rebuilt if the tiling changed
+void RenderThreadPool::SetTiling(int tileSize, TileOrder tileOrder, TileOrder pixelOrder) {
+    tileSize = std::max(1, tileSize);
+    std::lock_guard<std::mutex> frameLock(frameMutex);
+    if (tileSize == this->tileSize && tileOrder == this->tileOrder && pixelOrder == this->pixelOrder) return;
+    this->tileSize = tileSize;
+    this->tileOrder = tileOrder;
+    this->pixelOrder = pixelOrder;
+    grid.clear();
+}
 
-	std::cout << "Rendering with " << nThreads - 1 << " threads ..." << std::endl;
-    stop = false;
-    frameFinished = false;
+// Renders samples [sampleBegin, sampleEnd) of every pixel of every view (e.g. stereo eyes),
+// the kernel is called once per tile. Tiles of all views are scheduled as one job, the
+// views of a screen region next to each other so they share caches.
+// Returns false if the pool was stopped before or during the frame.
+bool RenderThreadPool::RenderTiles(int w, int h, int views, int sampleBegin, int sampleEnd, TileKernel& kernel) {
+    std::lock_guard<std::mutex> frameLock(frameMutex);
+    views = std::max(1, views);
+    if (grid.empty() || w != this->w || h != this->h || views != this->views) {
+        this->w = w;
+        this->h = h;
+        this->views = views;
+        grid = GenerateTilemap(w, h, tileSize, tileOrder);
+        tileCost = std::make_unique<std::atomic<uint64_t>[]>(grid.size() * views);
+        for (size_t i = 0; i < grid.size() * views; i++) tileCost[i] = 0;
+        hasTileCosts = false;
+    }
 
-    for (int i = 0; i < nThreads - 1; i++) {
-        workers.emplace_back(&RenderThreadPool::RenderWorker, this, render);
+    // Tile order on the first pass, most expensive tiles first once costs are known.
+    // Tiles are dealt round robin, so every deque holds a share of the expensive ones.
+    // Entry k is grid tile k / views, in view k % views.
+    std::vector<int> order(grid.size() * views);
+    for (size_t i = 0; i < order.size(); i++) order[i] = static_cast<int>(i);
+    if (hasTileCosts) {
+        std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+            return tileCost[a].load(std::memory_order_relaxed) > tileCost[b].load(std::memory_order_relaxed);
+        });
+    }
+    // With several nodes, each owns a contiguous block of the tile order (a screen region,
+    // for cache locality) and its tiles are dealt among the node's threads only
+    std::vector<std::vector<int>> nodeSlots(nodes);
+    for (int i = 0; i < nThreads; i++) nodeSlots[slotNode[i]].push_back(i);
+    std::vector<size_t> dealt(nodes, 0);
+    for (auto& q : queues) q->items.clear();
+    for (size_t i = 0; i < order.size(); i++) {
+        Tile tile = grid[order[i] / views];
+        tile.index = order[i];
+        tile.view = order[i] % views;
+        tile.sampleBegin = sampleBegin;
+        tile.sampleEnd = sampleEnd;
+        tile.pixelOrder = pixelOrder;
+        int node = static_cast<int>(static_cast<size_t>(order[i] / views) * nodes / grid.size());
+        const std::vector<int>& slots = nodeSlots[node];
+        queues[slots[dealt[node]++ % slots.size()]]->items.push_back(tile);
     }
+
+	if (verbose) std::cout << "Rendering with " << nThreads << " threads ..." << std::endl;
+    {
+        // Checked under jobMutex, so a concurrent Stop() either cancels the job before it
+        // starts or sees it in flight and waits for it
+        std::lock_guard<std::mutex> lock(jobMutex);
+        if (stop) return false;
+        this->kernel = &kernel;
+        forBody = nullptr;
+        outstanding = static_cast<int>(order.size());
+        queued = static_cast<int>(order.size());
+        idleThreads = 0;
+        steals = 0;
+        splits = 0;
+        remoteSteals = 0;
+        frameFinished = false;
+        activeThreads = nThreads;
+        startTime = std::chrono::steady_clock::now();
+        jobId++;
+    }
+    jobCv.notify_all();
+
+    // The submitting thread works on the frame as well, placed like a worker while it does
+    bool placed = false;
+    PlaceThread(0, placed);
+    RenderWorker(0);
+    FinishJob();
+    if (placed) Numa::BindCurrentThreadToNode(-1);
+    Numa::SetCurrentNode(0);
+
+    std::unique_lock<std::mutex> lock(jobMutex);
+    doneCv.wait(lock, [&] { return frameFinished.load(); });
+    hasTileCosts = !stop;
+    return !stop;
 }
 
+// Items are handed out by an atomic counter, the calling thread takes them like a worker but
+// stays unplaced
+bool RenderThreadPool::ParallelFor(int count, const std::function<void(int)>& body) {
+    std::lock_guard<std::mutex> frameLock(frameMutex);
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        if (stop) return false;
+        kernel = nullptr;
+        forBody = &body;
+        forCount = count;
+        forNext = 0;
+        frameFinished = false;
+        activeThreads = nThreads;
+        jobId++;
+    }
+    jobCv.notify_all();
+    ForWorker();
+    FinishJob();
+
+    std::unique_lock<std::mutex> lock(jobMutex);
+    doneCv.wait(lock, [&] { return frameFinished.load(); });
+    return !stop;
+}
+
+// Aborts the in-flight frame and waits until every thread left it. Threads check the flag
+// between the chunks of a tile, kernels may check Stopped() more often.
+// The pool stays stopped, frames are refused until Resume().
 void RenderThreadPool::Stop() {
+    RequestStop();
+    std::unique_lock<std::mutex> lock(jobMutex);
+    doneCv.wait(lock, [&] { return frameFinished.load(); });
+}
+
+// Like Stop(), without waiting
+void RenderThreadPool::RequestStop() {
     stop = true;
-    for (auto& t : workers) {
-        if (t.joinable()) t.join();
-    }
-    workers.clear();
+    WakeIdle(true);
 }
 
-void RenderThreadPool::Reset() {
-    for (auto& t : workers) {
-        if (t.joinable()) t.join();
-    }
-    activeThreads = 0;
+void RenderThreadPool::Resume() {
     stop = false;
-    tiles = 0;
-    workers.clear();
 }
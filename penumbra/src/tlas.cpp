@@ -0,0 +1,150 @@
+#include "tlas.h"
+
+#include <algorithm>
+
+Bounds Bounds::Transform(const glm::mat4& m) const {
+    Bounds out;
+    if (Empty()) return out;
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner((i & 1) ? hi.x : lo.x, (i & 2) ? hi.y : lo.y, (i & 4) ? hi.z : lo.z);
+        out.Grow(glm::vec3(m * glm::vec4(corner, 1.0f)));
+    }
+    return out;
+}
+
+TLAS::Update TLAS::Fit(const std::vector<Bounds>& shapeBounds) {
+    if (nodes.empty() || shapeIndices.size() != shapeBounds.size()) {
+        Build(shapeBounds);
+        return Update::Built;
+    }
+    Refit(shapeBounds);
+    if (SAHCost() > buildCost * TLAS_REBUILD_SAH_RATIO) {
+        Build(shapeBounds);
+        return Update::Rebuilt;
+    }
+    return Update::Refit;
+}
+
+void TLAS::Build(const std::vector<Bounds>& shapeBounds) {
+    nodes.clear();
+    shapeIndices.resize(shapeBounds.size());
+    for (uint32_t i = 0; i < shapeIndices.size(); i++) shapeIndices[i] = i;
+    if (shapeBounds.empty()) {
+        buildCost = 0.0f;
+        return;
+    }
+    nodes.reserve(2 * shapeBounds.size());
+    nodes.emplace_back();
+    nodes[0].leftFirst = 0;
+    nodes[0].count = static_cast<uint32_t>(shapeBounds.size());
+    Subdivide(0, shapeBounds, 0);
+    buildCost = SAHCost();
+}
+
+// Binned SAH split over the shape centers; children are allocated after their parent, so
+// a reverse sweep over the nodes refits bottom up. Skewed shape distributions can make the
+// tree deep, at TLAS_MAX_DEPTH nodes become leaves whatever their shape count.
+void TLAS::Subdivide(uint32_t node, const std::vector<Bounds>& shapeBounds, int depth) {
+    Node& n = nodes[node];
+    Bounds box, centers;
+    for (uint32_t i = 0; i < n.count; i++) {
+        const Bounds& b = shapeBounds[shapeIndices[n.leftFirst + i]];
+        box.Grow(b);
+        if (!b.Empty()) centers.Grow(b.Center());
+    }
+    n.lo = box.lo;
+    n.hi = box.hi;
+    if (n.count <= TLAS_LEAF_SIZE || centers.Empty() || depth >= TLAS_MAX_DEPTH) return;
+
+    int bestAxis = -1;
+    int bestSplit = 0;
+    float bestCost = box.Area() * n.count; // Cost of keeping the leaf
+    for (int axis = 0; axis < 3; axis++) {
+        float lo = centers.lo[axis], extent = centers.hi[axis] - lo;
+        if (extent <= 0.0f) continue;
+        Bounds bins[TLAS_BINS];
+        uint32_t counts[TLAS_BINS] = {};
+        for (uint32_t i = 0; i < n.count; i++) {
+            const Bounds& b = shapeBounds[shapeIndices[n.leftFirst + i]];
+            float c = b.Empty() ? lo : b.Center()[axis];
+            int bin = std::min(TLAS_BINS - 1, static_cast<int>((c - lo) / extent * TLAS_BINS));
+            bins[bin].Grow(b);
+            counts[bin]++;
+        }
+        // Sweep the bins from both sides for the area and count left and right of each plane
+        float leftArea[TLAS_BINS - 1];
+        uint32_t leftCount[TLAS_BINS - 1];
+        Bounds left;
+        uint32_t count = 0;
+        for (int i = 0; i < TLAS_BINS - 1; i++) {
+            left.Grow(bins[i]);
+            count += counts[i];
+            leftArea[i] = left.Area();
+            leftCount[i] = count;
+        }
+        Bounds right;
+        count = 0;
+        for (int i = TLAS_BINS - 1; i > 0; i--) {
+            right.Grow(bins[i]);
+            count += counts[i];
+            float cost = leftArea[i - 1] * leftCount[i - 1] + right.Area() * count;
+            if (leftCount[i - 1] > 0 && count > 0 && cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = i;
+            }
+        }
+    }
+    if (bestAxis < 0) return;
+
+    float lo = centers.lo[bestAxis], extent = centers.hi[bestAxis] - lo;
+    auto first = shapeIndices.begin() + n.leftFirst;
+    auto mid = std::partition(first, first + n.count, [&](uint32_t s) {
+        const Bounds& b = shapeBounds[s];
+        float c = b.Empty() ? lo : b.Center()[bestAxis];
+        return std::min(TLAS_BINS - 1, static_cast<int>((c - lo) / extent * TLAS_BINS)) < bestSplit;
+    });
+    uint32_t leftCount = static_cast<uint32_t>(mid - first);
+    uint32_t firstShape = n.leftFirst, count = n.count;
+
+    uint32_t child = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+    nodes.emplace_back();
+    nodes[child].leftFirst = firstShape;
+    nodes[child].count = leftCount;
+    nodes[child + 1].leftFirst = firstShape + leftCount;
+    nodes[child + 1].count = count - leftCount;
+    nodes[node].leftFirst = child; // n may dangle after emplace_back
+    nodes[node].count = 0;
+    Subdivide(child, shapeBounds, depth + 1);
+    Subdivide(child + 1, shapeBounds, depth + 1);
+}
+
+void TLAS::Refit(const std::vector<Bounds>& shapeBounds) {
+    for (size_t i = nodes.size(); i-- > 0;) {
+        Node& n = nodes[i];
+        Bounds box;
+        if (n.count > 0) {
+            for (uint32_t s = 0; s < n.count; s++) box.Grow(shapeBounds[shapeIndices[n.leftFirst + s]]);
+        }
+        else {
+            box.Grow(Bounds{ nodes[n.leftFirst].lo, nodes[n.leftFirst].hi });
+            box.Grow(Bounds{ nodes[n.leftFirst + 1].lo, nodes[n.leftFirst + 1].hi });
+        }
+        n.lo = box.lo;
+        n.hi = box.hi;
+    }
+}
+
+// Expected traversal cost relative to the root, one unit per node visit and shape test
+float TLAS::SAHCost() const {
+    if (nodes.empty()) return 0.0f;
+    float rootArea = Bounds{ nodes[0].lo, nodes[0].hi }.Area();
+    if (rootArea <= 0.0f) return 0.0f;
+    float cost = 0.0f;
+    for (const Node& n : nodes) {
+        float area = Bounds{ n.lo, n.hi }.Area() / rootArea;
+        cost += area * (n.count > 0 ? float(n.count) : 1.0f);
+    }
+    return cost;
+}
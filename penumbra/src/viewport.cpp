@@ -98,9 +98,10 @@ Viewport::Viewport(Renderer* renderer, int width, int height) :
     Renderer* r = renderer;
     gui->SetRenderCallback([this, r]() {
         auto rs = gui->GetRenderSettings();
-        strncpy(r->scenePath, rs.scenePath, sizeof(r->scenePath) - 1);
-        r->scenePath[sizeof(r->scenePath) - 1] = '\0';
-        std::thread([r]() { r->BeginRender(); }).detach();
+        r->StartRender(rs.scenePath);
+        });
+    gui->SetStopCallback([r]() {
+        r->CancelRender();
         });
     gui->SetSaveCallback([this, r]() {
         auto rs = gui->GetRenderSettings();
@@ -111,7 +112,18 @@ Viewport::Viewport(Renderer* renderer, int width, int height) :
         r->SaveImage();
 	});
     gui->SetRenderAnimCallback([r]() {
-        std::thread([r]() { r->RenderAnimation(); }).detach();
+        r->StartAnimation();
+    });
+    gui->SetCameraPathCallback([this, r]() {
+        auto rs = gui->GetRenderSettings();
+        r->StartCameraPath(rs.scenePath);
+    });
+    gui->SetSweepCallback([this, r]() {
+        auto rs = gui->GetRenderSettings();
+        r->StartTilingSweep(rs.scenePath);
+    });
+    gui->SetSceneEditCallback([r](const SceneParams& params) {
+        r->EditScene(params);
     });
     renderer->SetGUI(gui.get());
 	auto rs = gui->GetRenderSettings();
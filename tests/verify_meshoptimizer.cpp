@@ -0,0 +1,158 @@
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "meshoptimizer.h"
+#include "shapes.h"
+
+// Corners of a triangle, which the optimizer must keep whatever it renumbers
+struct Corner {
+    glm::vec3 p;
+    glm::vec3 n;
+    glm::vec2 uv;
+};
+
+static void Build(SubMesh& mesh, const std::vector<Corner>& vertices, const std::vector<glm::uvec3>& triangles) {
+    mesh.Allocate(static_cast<uint32_t>(vertices.size()), static_cast<uint32_t>(triangles.size()),
+                  MeshBuffers::Normals | MeshBuffers::Uvs | MeshBuffers::TangentFrames);
+    for (uint32_t i = 0; i < mesh.nVerts; i++) {
+        mesh.vertices[i] = glm::vec4(vertices[i].p, 0.0f);
+        mesh.normals[i] = vertices[i].n;
+        mesh.uvs[i] = vertices[i].uv;
+        mesh.tangents[i] = glm::vec3(1, 0, 0);
+        mesh.bitangents[i] = glm::vec3(0, 1, 0);
+    }
+    std::copy(triangles.begin(), triangles.end(), mesh.triangles);
+}
+
+using Key = std::array<float, 8>; // Position, normal and UV of a corner
+
+static Key CornerKey(const SubMesh& mesh, uint32_t i) {
+    const glm::vec4& p = mesh.vertices[i];
+    const glm::vec3& n = mesh.normals[i];
+    const glm::vec2& uv = mesh.uvs[i];
+    return { p.x, p.y, p.z, n.x, n.y, n.z, uv.x, uv.y };
+}
+
+// Triangles by their corners, each rotated to start at its smallest corner so the winding
+// is part of the comparison, then sorted
+static std::vector<std::array<Key, 3>> TriangleSet(const SubMesh& mesh) {
+    std::vector<std::array<Key, 3>> set;
+    for (uint32_t i = 0; i < mesh.nTris; i++) {
+        const glm::uvec3& t = mesh.triangles[i];
+        std::array<Key, 3> corners = { CornerKey(mesh, t.x), CornerKey(mesh, t.y), CornerKey(mesh, t.z) };
+        std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end()), corners.end());
+        set.push_back(corners);
+    }
+    std::sort(set.begin(), set.end());
+    return set;
+}
+
+static bool IndicesInRange(const SubMesh& mesh) {
+    for (uint32_t i = 0; i < mesh.nTris; i++) {
+        const glm::uvec3& t = mesh.triangles[i];
+        if (t.x >= mesh.nVerts || t.y >= mesh.nVerts || t.z >= mesh.nVerts) return false;
+    }
+    return true;
+}
+
+int main() {
+    std::cout << "Verifying mesh optimizer..." << std::endl;
+    std::cout << std::endl;
+
+    const glm::vec3 up(0, 0, 1);
+
+    // A quad whose two triangles each have their own copy of the shared corners
+    {
+        std::vector<Corner> vertices = {
+            { { 0, 0, 0 }, up, { 0, 0 } }, { { 1, 0, 0 }, up, { 1, 0 } }, { { 1, 1, 0 }, up, { 1, 1 } },
+            { { 0, 0, 0 }, up, { 0, 0 } }, { { 1, 1, 0 }, up, { 1, 1 } }, { { 0, 1, 0 }, up, { 0, 1 } },
+        };
+        SubMesh quad;
+        Build(quad, vertices, { { 0, 1, 2 }, { 3, 4, 5 } });
+        const auto before = TriangleSet(quad);
+        MeshOptimizer::Stats stats = MeshOptimizer::Optimize(quad);
+        if (quad.nVerts != 4 || quad.nTris != 2 || stats.vertsBefore != 6 || stats.vertsAfter != 4 ||
+            !IndicesInRange(quad) || TriangleSet(quad) != before) {
+            std::cout << "✗ Split quad welded to " << quad.nVerts << " vertices and " << quad.nTris << " triangles, expected 4 and 2" << std::endl;
+            return 1;
+        }
+        std::cout << "✓ Split vertex quad welds to 4 vertices" << std::endl;
+    }
+
+    // Seams stay: the same position with another UV is not welded
+    {
+        std::vector<Corner> vertices = {
+            { { 0, 0, 0 }, up, { 0, 0 } }, { { 1, 0, 0 }, up, { 1, 0 } }, { { 1, 1, 0 }, up, { 1, 1 } },
+            { { 0, 0, 0 }, up, { 0.5f, 0 } }, { { 1, 1, 0 }, up, { 1, 1 } }, { { 0, 1, 0 }, up, { 0, 1 } },
+        };
+        SubMesh seam;
+        Build(seam, vertices, { { 0, 1, 2 }, { 3, 4, 5 } });
+        const auto before = TriangleSet(seam);
+        MeshOptimizer::Optimize(seam);
+        if (seam.nVerts != 5 || TriangleSet(seam) != before) {
+            std::cout << "✗ UV seam welded to " << seam.nVerts << " vertices, expected 5" << std::endl;
+            return 1;
+        }
+        std::cout << "✓ UV seams are kept" << std::endl;
+    }
+
+    // Degenerate triangles (repeated index, zero area) and a duplicate are dropped
+    {
+        std::vector<Corner> vertices = {
+            { { 0, 0, 0 }, up, { 0, 0 } }, { { 1, 0, 0 }, up, { 1, 0 } }, { { 1, 1, 0 }, up, { 1, 1 } },
+            { { 0, 1, 0 }, up, { 0, 1 } }, { { 2, 0, 0 }, up, { 2, 0 } },
+        };
+        SubMesh mesh;
+        Build(mesh, vertices, {
+            { 0, 1, 2 }, { 0, 2, 3 },
+            { 0, 0, 1 }, // Repeated index
+            { 0, 1, 4 }, // Collinear
+            { 2, 0, 1 }, // { 0, 1, 2 } again, rotated
+        });
+        MeshOptimizer::Stats stats = MeshOptimizer::Optimize(mesh);
+        if (mesh.nTris != 2 || stats.degenerate != 2 || stats.duplicate != 1 || mesh.nVerts != 4 || !IndicesInRange(mesh)) {
+            std::cout << "✗ Cleanup left " << mesh.nTris << " triangles over " << mesh.nVerts << " vertices, dropped "
+                      << stats.degenerate << " degenerate and " << stats.duplicate << " duplicate" << std::endl;
+            return 1;
+        }
+        std::cout << "✓ Degenerate and duplicate triangles are dropped" << std::endl;
+    }
+
+    // A shuffled grid: reordering keeps every triangle, its winding and its attributes
+    {
+        const int n = 24;
+        std::vector<Corner> vertices;
+        std::vector<glm::uvec3> triangles;
+        auto corner = [&](int i, int j) {
+            vertices.push_back({ { float(i), float(j), 0.05f * float((i * 7 + j * 3) % 5) }, up, { i / float(n), j / float(n) } });
+            return static_cast<uint32_t>(vertices.size() - 1);
+        };
+        for (int j = 0; j < n; j++) {
+            for (int i = 0; i < n; i++) {
+                triangles.push_back({ corner(i, j), corner(i + 1, j), corner(i + 1, j + 1) });
+                triangles.push_back({ corner(i, j), corner(i + 1, j + 1), corner(i, j + 1) });
+            }
+        }
+        std::shuffle(triangles.begin(), triangles.end(), std::mt19937(7));
+        SubMesh grid;
+        Build(grid, vertices, triangles);
+        const auto before = TriangleSet(grid);
+        MeshOptimizer::Optimize(grid);
+        if (grid.nVerts != uint32_t((n + 1) * (n + 1)) || grid.nTris != uint32_t(2 * n * n) || !IndicesInRange(grid) ||
+            TriangleSet(grid) != before) {
+            std::cout << "✗ Reordered grid differs: " << grid.nVerts << " vertices, " << grid.nTris << " triangles" << std::endl;
+            return 1;
+        }
+        std::cout << "✓ Reordering keeps the triangle set" << std::endl;
+    }
+
+    std::cout << std::endl;
+    std::cout << "Mesh optimizer verified" << std::endl;
+    return 0;
+}
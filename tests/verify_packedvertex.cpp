@@ -0,0 +1,165 @@
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "shapes.h"
+
+// Decoding error bounds, as the length of the difference to the unit vector that was packed.
+// 16 bit octahedral snorms land within about 1e-4; the tangent gives up a bit to the
+// bitangent sign and the bitangent is rebuilt from both.
+#define NORMAL_MAX_ERROR 2e-4f
+#define TANGENT_MAX_ERROR 4e-4f
+#define BITANGENT_MAX_ERROR 4e-4f
+
+static glm::vec3 Orthogonal(const glm::vec3& d) {
+    const glm::vec3 axis = std::abs(d.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+    return glm::normalize(glm::cross(d, axis));
+}
+
+// Directions over the whole sphere: a Fibonacci spiral, the poles and axes, and directions
+// along the octahedron's edges and folds, where the encoding changes branch
+static std::vector<glm::vec3> Directions() {
+    std::vector<glm::vec3> dirs;
+    const int spiral = 20000;
+    const float golden = 3.14159265f * (3.0f - std::sqrt(5.0f));
+    for (int i = 0; i < spiral; i++) {
+        float z = 1.0f - 2.0f * (i + 0.5f) / spiral;
+        float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        dirs.push_back(glm::vec3(r * std::cos(golden * i), r * std::sin(golden * i), z));
+    }
+    const float eps[] = { 0.0f, 1e-6f, 1e-4f, 1e-2f };
+    for (float s : { -1.0f, 1.0f }) {
+        dirs.push_back(glm::vec3(s, 0, 0));
+        dirs.push_back(glm::vec3(0, s, 0));
+        dirs.push_back(glm::vec3(0, 0, s));
+        for (float e : eps) {
+            // Near the poles
+            dirs.push_back(glm::normalize(glm::vec3(e, e, s)));
+            dirs.push_back(glm::normalize(glm::vec3(-e, e, s)));
+            // The equator, where the lower hemisphere folds over
+            for (float t : { -1.0f, 1.0f }) {
+                dirs.push_back(glm::normalize(glm::vec3(s, t, -e)));
+                dirs.push_back(glm::normalize(glm::vec3(s, t, e)));
+                dirs.push_back(glm::normalize(glm::vec3(s, e, -e)));
+                dirs.push_back(glm::normalize(glm::vec3(e, s, -e)));
+                // The edges x = 0 and y = 0 of the folded (-Z) half, and the +Z half
+                dirs.push_back(glm::normalize(glm::vec3(e, s, t)));
+                dirs.push_back(glm::normalize(glm::vec3(s, e, t)));
+                dirs.push_back(glm::normalize(glm::vec3(-e, s, t)));
+                dirs.push_back(glm::normalize(glm::vec3(s, -e, t)));
+            }
+        }
+    }
+    return dirs;
+}
+
+int main() {
+    std::cout << "Verifying packed vertices..." << std::endl;
+    std::cout << std::endl;
+
+    // Each direction is packed once as a normal and once as a tangent, every other vertex
+    // with a mirrored tangent frame. UVs run outside [0, 1], over as wide a range as is still
+    // quantized (PACKED_UV_MAX_EXTENT).
+    const std::vector<glm::vec3> dirs = Directions();
+    const uint32_t nVerts = static_cast<uint32_t>(2 * dirs.size());
+    std::vector<glm::vec3> normals(nVerts), tangents(nVerts), bitangents(nVerts);
+    std::vector<glm::vec2> uvs(nVerts);
+    for (size_t i = 0; i < dirs.size(); i++) {
+        normals[2 * i] = dirs[i];
+        tangents[2 * i] = Orthogonal(dirs[i]);
+        tangents[2 * i + 1] = dirs[i];
+        normals[2 * i + 1] = Orthogonal(dirs[i]);
+    }
+    for (uint32_t i = 0; i < nVerts; i++) {
+        bitangents[i] = glm::cross(normals[i], tangents[i]) * (i % 2 ? -1.0f : 1.0f);
+        const float s = static_cast<float>(i) / static_cast<float>(nVerts - 1);
+        uvs[i] = glm::vec2(-0.5f + 2.0f * s, 1.25f - 1.75f * std::sqrt(s));
+    }
+    uvs[0] = glm::vec2(-0.5f, 1.25f);
+    uvs[nVerts - 1] = glm::vec2(1.5f, -0.5f);
+
+    SubMesh mesh;
+    mesh.Allocate(nVerts, nVerts, MeshBuffers::Normals | MeshBuffers::Uvs | MeshBuffers::TangentFrames);
+    for (uint32_t i = 0; i < nVerts; i++) {
+        mesh.vertices[i] = glm::vec4(0.0f);
+        mesh.triangles[i] = glm::uvec3(i, i, i); // Interpolates to vertex i alone
+        mesh.normals[i] = normals[i];
+        mesh.tangents[i] = tangents[i];
+        mesh.bitangents[i] = bitangents[i];
+        mesh.uvs[i] = uvs[i];
+    }
+    mesh.Pack();
+    if (!mesh.packed || mesh.normals || mesh.uvs || !(mesh.GetAttributes() & MeshBuffers::Packed)) {
+        std::cout << "✗ Mesh was not packed" << std::endl;
+        return 1;
+    }
+
+    // Half a unorm16 step of the UV range, plus float rounding
+    const glm::vec2 uvMaxError = glm::vec2(2.0f, 1.75f) * (0.5f / 65535.0f) + glm::vec2(1e-6f);
+    float maxN = 0.0f, maxT = 0.0f, maxB = 0.0f;
+    glm::vec2 maxUV(0.0f);
+    for (uint32_t i = 0; i < nVerts; i++) {
+        glm::vec3 n, t, b;
+        glm::vec2 uv;
+        mesh.Interpolate(mesh.triangles[i], 0.0f, 0.0f, n, t, b, uv);
+        const float errN = glm::length(n - normals[i]);
+        const float errT = glm::length(t - tangents[i]);
+        const float errB = glm::length(b - bitangents[i]);
+        const glm::vec2 errUV(std::abs(uv.x - uvs[i].x), std::abs(uv.y - uvs[i].y));
+        maxN = std::max(maxN, errN);
+        maxT = std::max(maxT, errT);
+        maxB = std::max(maxB, errB);
+        maxUV = glm::max(maxUV, errUV);
+        if (!(errN <= NORMAL_MAX_ERROR) || !(errT <= TANGENT_MAX_ERROR) || !(errB <= BITANGENT_MAX_ERROR) ||
+            !(errUV.x <= uvMaxError.x) || !(errUV.y <= uvMaxError.y)) {
+            std::cout << "✗ Vertex " << i << " decodes with errors n " << errN << ", t " << errT << ", b " << errB
+                      << ", uv " << errUV.x << " " << errUV.y << std::endl;
+            std::cout << "  normal (" << normals[i].x << ", " << normals[i].y << ", " << normals[i].z << "), tangent ("
+                      << tangents[i].x << ", " << tangents[i].y << ", " << tangents[i].z << ")" << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "✓ Normals round trip over the sphere, max error " << maxN << std::endl;
+    std::cout << "✓ Tangents round trip over the sphere, max error " << maxT << std::endl;
+    std::cout << "✓ Bitangents keep their sign, max error " << maxB << std::endl;
+    std::cout << "✓ UVs outside [0, 1] round trip, max error " << std::max(maxUV.x, maxUV.y) << std::endl;
+
+    // A tiled floor: 16 bit UVs over [0, 50] would be off by texels of every repeat, they
+    // stay full precision
+    {
+        const int n = 51;
+        SubMesh floor;
+        floor.Allocate(n * n, n * n, MeshBuffers::Normals | MeshBuffers::Uvs);
+        for (int i = 0; i < n * n; i++) {
+            floor.vertices[i] = glm::vec4(float(i % n), 0.0f, float(i / n), 0.0f);
+            floor.triangles[i] = glm::uvec3(i, i, i);
+            floor.normals[i] = glm::vec3(0, 1, 0);
+            floor.uvs[i] = glm::vec2(float(i % n), float(i / n)) + glm::vec2(1.0f / 4096.0f, 3.0f / 4096.0f);
+        }
+        std::vector<glm::vec2> tiled(floor.uvs, floor.uvs + n * n);
+        floor.Pack();
+        if (!floor.packed || !floor.uvs || !(floor.GetAttributes() & MeshBuffers::FullUvs)) {
+            std::cout << "✗ Tiled UVs were quantized" << std::endl;
+            return 1;
+        }
+        for (int i = 0; i < n * n; i++) {
+            glm::vec3 nn, t, b;
+            glm::vec2 uv;
+            floor.Interpolate(floor.triangles[i], 0.0f, 0.0f, nn, t, b, uv);
+            if (uv != tiled[i] || !(glm::length(nn - glm::vec3(0, 1, 0)) <= NORMAL_MAX_ERROR)) {
+                std::cout << "✗ Tiled vertex " << i << " decodes UV (" << uv.x << ", " << uv.y << "), expected ("
+                          << tiled[i].x << ", " << tiled[i].y << ")" << std::endl;
+                return 1;
+            }
+        }
+        std::cout << "✓ Tiled UVs over [0, 50] keep full precision" << std::endl;
+    }
+
+    std::cout << std::endl;
+    std::cout << "Packed vertices verified" << std::endl;
+    return 0;
+}
@@ -0,0 +1,206 @@
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "plyloader.h"
+
+// A unit quad and a triangle sharing its right edge: 5 vertices, a 4 and a 3 vertex face
+static const float positions[5][3] = { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 }, { 2, 0, 0 } };
+static const float uvs[5][2] = { { 0, 0 }, { 0.5f, 0 }, { 0.5f, 1 }, { 0, 1 }, { 1, 0 } };
+static const std::vector<std::vector<uint32_t>> faces = { { 0, 1, 2, 3 }, { 1, 4, 2 } };
+// Fan triangulated, in file winding
+static const std::vector<glm::uvec3> expectedTriangles = { { 0, 1, 2 }, { 0, 2, 3 }, { 1, 4, 2 } };
+
+static void WriteHeader(std::ofstream& out, const char* format) {
+    out << "ply\nformat " << format << " 1.0\n"
+        << "element vertex 5\n"
+        << "property float x\nproperty float y\nproperty float z\n"
+        << "property float nx\nproperty float ny\nproperty float nz\n"
+        << "property float s\nproperty float t\n"
+        << "element face " << faces.size() << "\n"
+        << "property list uchar int vertex_indices\n"
+        << "end_header\n";
+}
+
+static void WriteAscii(const std::string& path) {
+    std::ofstream out(path, std::ios::binary);
+    WriteHeader(out, "ascii");
+    for (int i = 0; i < 5; i++) {
+        out << positions[i][0] << " " << positions[i][1] << " " << positions[i][2] << " 0 0 1 "
+            << uvs[i][0] << " " << uvs[i][1] << "\n";
+    }
+    for (const auto& face : faces) {
+        out << face.size();
+        for (uint32_t index : face) out << " " << index;
+        out << "\n";
+    }
+}
+
+// Little endian whatever the host
+static void WriteLE(std::ofstream& out, uint32_t bits) {
+    const char bytes[4] = { char(bits & 0xff), char((bits >> 8) & 0xff), char((bits >> 16) & 0xff), char(bits >> 24) };
+    out.write(bytes, 4);
+}
+
+static void WriteLE(std::ofstream& out, float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, 4);
+    WriteLE(out, bits);
+}
+
+static void WriteBinary(const std::string& path) {
+    std::ofstream out(path, std::ios::binary);
+    WriteHeader(out, "binary_little_endian");
+    for (int i = 0; i < 5; i++) {
+        for (float p : positions[i]) WriteLE(out, p);
+        for (float n : { 0.0f, 0.0f, 1.0f }) WriteLE(out, n);
+        for (float uv : uvs[i]) WriteLE(out, uv);
+    }
+    for (const auto& face : faces) {
+        out.put(char(face.size()));
+        for (uint32_t index : face) WriteLE(out, index);
+    }
+}
+
+using Triangle = std::array<glm::vec3, 3>;
+
+static bool Less(const glm::vec3& a, const glm::vec3& b) {
+    if (a.x != b.x) return a.x < b.x;
+    if (a.y != b.y) return a.y < b.y;
+    return a.z < b.z;
+}
+
+// Rotated to start at its smallest corner, so equal triangles compare equal only with the same winding
+static Triangle Canonical(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    Triangle t = { a, b, c };
+    int first = 0;
+    for (int i = 1; i < 3; i++) {
+        if (Less(t[i], t[first])) first = i;
+    }
+    return { t[first], t[(first + 1) % 3], t[(first + 2) % 3] };
+}
+
+static std::vector<Triangle> Sorted(std::vector<Triangle> triangles) {
+    std::sort(triangles.begin(), triangles.end(), [](const Triangle& a, const Triangle& b) {
+        for (int i = 0; i < 3; i++) {
+            if (Less(a[i], b[i])) return true;
+            if (Less(b[i], a[i])) return false;
+        }
+        return false;
+    });
+    return triangles;
+}
+
+static std::vector<Triangle> Triangles(const PlyLoader::Mesh& mesh) {
+    std::vector<Triangle> triangles;
+    for (const glm::uvec3& t : mesh.triangles) {
+        triangles.push_back(Canonical(glm::vec3(mesh.vertices[t.x]), glm::vec3(mesh.vertices[t.y]), glm::vec3(mesh.vertices[t.z])));
+    }
+    return Sorted(triangles);
+}
+
+// Triangles of every mesh Assimp imports from the file, in file winding. Counts the distinct positions.
+static bool ImportWithAssimp(const std::string& path, std::vector<Triangle>& triangles, size_t& positionCount) {
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate);
+    if (!scene || scene->mNumMeshes == 0) {
+        std::cout << "  Assimp: " << importer.GetErrorString() << std::endl;
+        return false;
+    }
+    std::vector<glm::vec3> distinct;
+    for (unsigned m = 0; m < scene->mNumMeshes; m++) {
+        const aiMesh* mesh = scene->mMeshes[m];
+        auto position = [&](unsigned i) { return glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z); };
+        for (unsigned i = 0; i < mesh->mNumVertices; i++) {
+            glm::vec3 p = position(i);
+            if (std::find(distinct.begin(), distinct.end(), p) == distinct.end()) distinct.push_back(p);
+        }
+        for (unsigned f = 0; f < mesh->mNumFaces; f++) {
+            const aiFace& face = mesh->mFaces[f];
+            if (face.mNumIndices != 3) return false;
+            triangles.push_back(Canonical(position(face.mIndices[0]), position(face.mIndices[1]), position(face.mIndices[2])));
+        }
+    }
+    triangles = Sorted(triangles);
+    positionCount = distinct.size();
+    return true;
+}
+
+int main() {
+    std::cout << "Verifying PLY loader..." << std::endl;
+    std::cout << std::endl;
+
+    const std::filesystem::path dir = std::filesystem::temp_directory_path();
+    const std::string binaryPath = (dir / "penumbra_verify_binary_le.ply").string();
+    const std::string asciiPath = (dir / "penumbra_verify_ascii.ply").string();
+    WriteBinary(binaryPath);
+    WriteAscii(asciiPath);
+
+    // Binary little endian, read natively
+    PlyLoader::Mesh mesh;
+    std::string error;
+    if (!PlyLoader::Read(binaryPath, mesh, error)) {
+        std::cout << "✗ Binary PLY not read: " << error << std::endl;
+        return 1;
+    }
+    if (mesh.vertices.size() != 5 || mesh.normals.size() != 5 || mesh.uvs.size() != 5 || mesh.triangles != expectedTriangles) {
+        std::cout << "✗ Binary PLY read " << mesh.vertices.size() << " vertices, " << mesh.triangles.size()
+                  << " triangles, expected 5 and " << expectedTriangles.size() << " in file winding" << std::endl;
+        return 1;
+    }
+    for (int i = 0; i < 5; i++) {
+        if (glm::vec3(mesh.vertices[i]) != glm::vec3(positions[i][0], positions[i][1], positions[i][2]) ||
+            mesh.normals[i] != glm::vec3(0, 0, 1) || mesh.uvs[i] != glm::vec2(uvs[i][0], uvs[i][1])) {
+            std::cout << "✗ Binary PLY vertex " << i << " differs from the file" << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "✓ Binary PLY read natively" << std::endl;
+
+    // Same triangles, with the same winding, as the Assimp path
+    std::vector<Triangle> assimpTriangles;
+    size_t assimpPositions = 0;
+    if (!ImportWithAssimp(binaryPath, assimpTriangles, assimpPositions)) {
+        std::cout << "✗ Assimp could not import the binary PLY" << std::endl;
+        return 1;
+    }
+    if (assimpPositions != mesh.vertices.size() || assimpTriangles != Triangles(mesh)) {
+        std::cout << "✗ Binary PLY differs from Assimp: " << assimpTriangles.size() << " triangles over "
+                  << assimpPositions << " positions" << std::endl;
+        return 1;
+    }
+    std::cout << "✓ Binary PLY matches Assimp" << std::endl;
+
+    // ASCII is left to Assimp, which must import the same mesh
+    PlyLoader::Mesh ascii;
+    error.clear();
+    if (PlyLoader::Read(asciiPath, ascii, error) || error.empty()) {
+        std::cout << "✗ ASCII PLY was not handed to Assimp" << std::endl;
+        return 1;
+    }
+    std::vector<Triangle> asciiTriangles;
+    size_t asciiPositions = 0;
+    if (!ImportWithAssimp(asciiPath, asciiTriangles, asciiPositions) ||
+        asciiPositions != mesh.vertices.size() || asciiTriangles != Triangles(mesh)) {
+        std::cout << "✗ ASCII PLY through Assimp differs from the binary one" << std::endl;
+        return 1;
+    }
+    std::cout << "✓ ASCII PLY falls back to Assimp (" << error << ")" << std::endl;
+
+    std::filesystem::remove(binaryPath);
+    std::filesystem::remove(asciiPath);
+    std::cout << std::endl;
+    std::cout << "PLY loader verified" << std::endl;
+    return 0;
+}